@@ -5,12 +5,13 @@ Implements the full three-phase presence engine:
 - Z-score calculation with runtime thresholds
 - 4-state debounced state machine
 - Phase 3 distance windowing + MAD-based calibration services
+- Two-class (empty/occupied) calibration deriving k_on/k_off
 """
 import esphome.codegen as cg
 from esphome.components import binary_sensor
 
 DEPENDENCIES = []
-AUTO_LOAD = ["binary_sensor"]
+AUTO_LOAD = ["binary_sensor", "sensor", "text_sensor"]
 
 # Define the namespace and class
 bed_presence_engine_ns = cg.esphome_ns.namespace("bed_presence_engine")
@@ -3,19 +3,96 @@
 #include <algorithm>
 #include <cmath>
 
+#ifdef USE_ESP32
+#include <esp_attr.h>
+#endif
+
 namespace esphome {
 namespace bed_presence_engine {
 
 static const char *const TAG = "bed_presence_engine";
 
+constexpr float EngineProfile::K_MAX;  // ODR-used by reference binding (C++14)
+
+// Black-box memory lives outside the component so it can sit in RTC no-init RAM and outlive a soft reboot;
+// elsewhere it is ordinary RAM and starts fresh on every boot
+#ifdef USE_ESP32
+static RTC_NOINIT_ATTR BlackBoxStorage black_box_storage;
+#else
+static BlackBoxStorage black_box_storage;
+#endif
+
+static const char *black_box_state_name(uint8_t state) {
+  switch (state) {
+    case IDLE:
+      return "IDLE";
+    case DEBOUNCING_ON:
+      return "DEBOUNCING_ON";
+    case PRESENT:
+      return "PRESENT";
+    case DEBOUNCING_OFF:
+      return "DEBOUNCING_OFF";
+    default:
+      return "?";
+  }
+}
+
+static const char *black_box_reason_name(BlackBoxFreezeReason reason) {
+  switch (reason) {
+    case BLACK_BOX_FROZEN_ON:
+      return "on";
+    case BLACK_BOX_FROZEN_OFF:
+      return "off";
+    case BLACK_BOX_FROZEN_MANUAL:
+      return "manual";
+    default:
+      return "none";
+  }
+}
+
+// One CSV line per record: index,t_ms,z,state,gate,debounce_s,since_high_s
+static void log_black_box_record(size_t index, const BlackBoxRecord &rec) {
+  if (rec.state == BlackBoxRecord::BOOT_MARKER) {
+    ESP_LOGI(TAG, "bb,%u,boot", static_cast<unsigned>(index));
+    return;
+  }
+  ESP_LOGI(TAG, "bb,%u,%lu,%.2f,%s,%u,%.1f,%.1f", static_cast<unsigned>(index), static_cast<unsigned long>(rec.t_ms),
+           rec.z_centi / 100.0f, black_box_state_name(rec.state), static_cast<unsigned>(rec.gate),
+           rec.debounce_ds / 10.0f, rec.high_ds / 10.0f);
+}
+
 void BedPresenceEngine::setup() {
   ESP_LOGCONFIG(TAG, "Setting up Bed Presence Engine (Phase 3)...");
-  ESP_LOGCONFIG(TAG, "  Baseline (still): μ=%.2f, σ=%.2f", this->mu_still_, this->sigma_still_);
+  ESP_LOGCONFIG(TAG, "  Baseline (still): μ=%.2f, σ=%.2f", DecisionMath::to_float(this->mu_still_),
+                DecisionMath::to_float(this->sigma_still_));
+#ifdef BED_PRESENCE_FIXED_POINT
+  ESP_LOGCONFIG(TAG, "  Decision math: Q%d.%d fixed point", 31 - BED_PRESENCE_Q_FRAC_BITS, BED_PRESENCE_Q_FRAC_BITS);
+#endif
   ESP_LOGCONFIG(TAG, "  Baseline (stat): μ=%.2f, σ=%.2f", this->mu_stat_, this->sigma_stat_);
-  ESP_LOGCONFIG(TAG, "  Threshold multipliers: k_on=%.2f, k_off=%.2f", this->k_on_, this->k_off_);
+  const EngineProfile &profile = this->profiles_.active();
+  ESP_LOGCONFIG(TAG, "  Profile '%s' (%u presets)", profile.name,
+                static_cast<unsigned>(this->profiles_.preset_count()));
+  ESP_LOGCONFIG(TAG, "  Threshold multipliers: k_on=%.2f, k_off=%.2f", profile.k_on, profile.k_off);
   ESP_LOGCONFIG(TAG, "  Debounce timers: on=%lums, off=%lums, abs_clear=%lums",
-                this->on_debounce_ms_, this->off_debounce_ms_, this->abs_clear_delay_ms_);
-  ESP_LOGCONFIG(TAG, "  Distance window: [%.1fcm, %.1fcm]", this->d_min_cm_, this->d_max_cm_);
+                profile.on_debounce_ms, profile.off_debounce_ms, profile.abs_clear_delay_ms);
+  ESP_LOGCONFIG(TAG, "  Distance window: [%.1fcm, %.1fcm], gate mode=%d, soft margin=%.1fcm", profile.d_min_cm,
+                profile.d_max_cm, this->distance_gate_mode_, DecisionMath::to_float(this->distance_soft_margin_cm_));
+  if (profile.validate() != nullptr) {
+    ESP_LOGW(TAG, "  Configured profile is inconsistent (%s)", profile.validate());
+  }
+  ESP_LOGCONFIG(TAG, "  Idle decimation: %u frames/block, wake margin=%.2f", this->cadence_.decimation(),
+                this->cadence_wake_margin_);
+  if (this->occupancy_probability_sensor_ != nullptr) {
+    ESP_LOGCONFIG(TAG, "  Occupancy probability: 5-state HMM forward filter enabled");
+  }
+  // Storage may already be attached (native replay runs one engine per thread, each with its own)
+  bool recovered = false;
+  this->black_box_.set_transient_states((1u << DEBOUNCING_ON) | (1u << DEBOUNCING_OFF));
+  if (!this->black_box_.attached()) {
+    recovered = this->black_box_.attach(&black_box_storage);
+  }
+  ESP_LOGCONFIG(TAG, "  Black box: %u records, boot #%u%s", static_cast<unsigned>(BlackBoxStorage::CAPACITY),
+                static_cast<unsigned>(this->black_box_.boot_count()), recovered ? " (recording retained)" : "");
   ESP_LOGCONFIG(TAG, "  Phase 3: Distance windowing + MAD calibration enabled");
 
   // Initialize to IDLE state
@@ -28,72 +105,194 @@ void BedPresenceEngine::setup() {
   if (this->last_change_reason_sensor_ != nullptr) {
     this->last_change_reason_sensor_->publish_state("idle:init");
   }
+  if (recovered && this->black_box_.latest_frozen() != BLACK_BOX_NOT_FROZEN) {
+    this->publish_black_box_status("recovered");
+  }
 }
 
 void BedPresenceEngine::loop() {
-  if (this->calibrating_ && millis() >= this->calibration_end_time_) {
+  // Staged knob updates only ever take effect here, between frames
+  this->commit_pending_profile();
+
+  if (this->calibration_phase_ != CALIBRATION_NONE && millis() >= this->calibration_end_time_) {
     this->finalize_calibration();
   }
 
+  unsigned long now = millis();
+  if (now - this->last_diagnostics_time_ >= DIAGNOSTICS_INTERVAL_MS) {
+    this->last_diagnostics_time_ = now;
+    this->publish_diagnostics();
+  }
+
+  float moving_energy = 0.0f;
+  if (this->moving_energy_sensor_ != nullptr && this->moving_energy_sensor_->has_state()) {
+    moving_energy = this->moving_energy_sensor_->state;
+  }
+  if (this->session_tracker_.update(now, this->state, moving_energy)) {
+    this->publish_session_summary();
+  }
+
   // Check if we have a valid energy reading
   if (this->energy_sensor_ == nullptr || !this->energy_sensor_->has_state()) {
     return;
   }
 
-  if (this->distance_sensor_ != nullptr && this->distance_sensor_->has_state()) {
-    float distance = this->distance_sensor_->state;
-    if (distance < this->d_min_cm_ || distance > this->d_max_cm_) {
-      ESP_LOGVV(TAG, "Ignoring frame, distance %.2fcm outside window [%.1fcm, %.1fcm]", distance, this->d_min_cm_,
-                this->d_max_cm_);
+  const EngineProfile &profile = this->profiles_.active();
+  const DecisionThresholds &thresholds = this->decision_thresholds(profile);
+  float energy = this->energy_sensor_->state;
+  decision_t value = DecisionMath::from_float(energy);
+
+  // Adaptive cadence: quiet IDLE frames far below k_on are folded into block means
+  bool may_decimate = this->current_state_ == IDLE && this->calibration_phase_ == CALIBRATION_NONE;
+  if (!this->cadence_.admit(value, may_decimate, thresholds.wake_energy)) {
+    return;
+  }
+
+  const decision_t full_weight = DecisionMath::from_float(1.0f);
+  decision_t weight = this->distance_gate_weight(thresholds);
+  this->frame_gate_ = weight >= full_weight ? BLACK_BOX_IN_WINDOW : BLACK_BOX_ATTENUATED;
+
+  if (weight >= full_weight) {
+    this->frames_in_window_++;
+    // Calibration only learns from frames inside the bed zone (never decimated, so `energy` is this frame's)
+    this->handle_calibration_sample(energy);
+  } else {
+    if (weight > 0) {
+      this->frames_attenuated_++;
+    } else {
+      this->frames_out_of_window_++;
+    }
+    if (this->calibration_phase_ != CALIBRATION_NONE) {
+      this->calibration_quality_.add_rejected();
+    }
+
+    if (this->distance_gate_mode_ == GATE_HARD) {
+      ESP_LOGVV(TAG, "Ignoring frame, distance %.2fcm outside window [%.1fcm, %.1fcm]",
+                this->distance_sensor_->state, profile.d_min_cm, profile.d_max_cm);
+      this->frame_gate_ = BLACK_BOX_OUT_OF_WINDOW;
+      decision_t z_still = this->calculate_z_score(value, this->mu_still_, this->sigma_still_);
+      this->record_black_box(now, z_still);
       return;
     }
+
+    // Keep the state machine advancing: only the evidence above baseline is scaled
+    value = DecisionMath::blend(this->mu_still_, weight, value);
+    ESP_LOGVV(TAG, "Gated frame, distance %.2fcm, weight=%.2f, energy=%.2f", this->distance_sensor_->state,
+              DecisionMath::to_float(weight), DecisionMath::to_float(value));
   }
 
-  float energy = this->energy_sensor_->state;
-  this->handle_calibration_sample(energy);
-  this->process_energy_reading(energy);
+  this->process_energy_reading(value);
 }
 
-float BedPresenceEngine::calculate_z_score(float energy, float mu, float sigma) {
+const BedPresenceEngine::DecisionThresholds &BedPresenceEngine::decision_thresholds(const EngineProfile &profile) {
+  if (!this->thresholds_stale_ && this->thresholds_generation_ == this->profiles_.generation()) {
+    return this->thresholds_;
+  }
+
+  // Profile install, commit or select, or a new baseline: convert once instead of every frame
+  DecisionThresholds &t = this->thresholds_;
+  t.k_on = DecisionMath::from_float(profile.k_on);
+  t.k_off = DecisionMath::from_float(profile.k_off);
+  t.wake_energy =
+      this->mu_still_ +
+      DecisionMath::mul(this->sigma_still_, DecisionMath::from_float(profile.k_on - this->cadence_wake_margin_));
+  t.d_min_cm = DecisionMath::from_float(profile.d_min_cm);
+  t.d_max_cm = DecisionMath::from_float(profile.d_max_cm);
+  this->thresholds_generation_ = this->profiles_.generation();
+  this->thresholds_stale_ = false;
+  return t;
+}
+
+decision_t BedPresenceEngine::distance_gate_weight(const DecisionThresholds &thresholds) const {
+  if (this->distance_sensor_ == nullptr || !this->distance_sensor_->has_state()) {
+    return DecisionMath::from_float(1.0f);
+  }
+
+  decision_t distance = DecisionMath::from_float(this->distance_sensor_->state);
+  decision_t outside;
+  if (distance < thresholds.d_min_cm) {
+    outside = thresholds.d_min_cm - distance;
+  } else if (distance > thresholds.d_max_cm) {
+    outside = distance - thresholds.d_max_cm;
+  } else {
+    return DecisionMath::from_float(1.0f);
+  }
+
+  if (this->distance_gate_mode_ != GATE_SOFT || outside >= this->distance_soft_margin_cm_) {
+    return DecisionMath::from_float(0.0f);
+  }
+
+  // Smoothstep falloff: 1 at the window edge, 0 at the edge of the soft margin
+  return DecisionMath::falloff(outside, this->distance_soft_margin_cm_);
+}
+
+void BedPresenceEngine::publish_diagnostics() {
+  if (this->frames_processed_sensor_ != nullptr) {
+    this->frames_processed_sensor_->publish_state(this->cadence_.frames_processed());
+  }
+  if (this->frames_decimated_sensor_ != nullptr) {
+    this->frames_decimated_sensor_->publish_state(this->cadence_.frames_skipped());
+  }
+  if (this->frames_in_window_sensor_ != nullptr) {
+    this->frames_in_window_sensor_->publish_state(this->frames_in_window_);
+  }
+  if (this->frames_attenuated_sensor_ != nullptr) {
+    this->frames_attenuated_sensor_->publish_state(this->frames_attenuated_);
+  }
+  if (this->frames_out_of_window_sensor_ != nullptr) {
+    this->frames_out_of_window_sensor_->publish_state(this->frames_out_of_window_);
+  }
+}
+
+decision_t BedPresenceEngine::calculate_z_score(decision_t energy, decision_t mu, decision_t sigma) {
   // Prevent division by zero
-  if (sigma <= 0.001f) {
-    ESP_LOGW(TAG, "Invalid sigma (%.2f), returning z=0", sigma);
-    return 0.0f;
+  if (sigma <= DecisionMath::SIGMA_EPSILON) {
+    ESP_LOGW(TAG, "Invalid sigma (%.2f), returning z=0", DecisionMath::to_float(sigma));
+    return DecisionMath::from_float(0.0f);
   }
 
   // z = (x - μ) / σ
-  return (energy - mu) / sigma;
+  return DecisionMath::z_score(energy, mu, sigma);
 }
 
-void BedPresenceEngine::process_energy_reading(float energy) {
-  // Calculate z-score for still energy (Phase 2 uses still_energy)
-  float z_still = this->calculate_z_score(energy, this->mu_still_, this->sigma_still_);
+void BedPresenceEngine::process_energy_reading(decision_t energy) {
+  // Calculate z-score for still energy (Phase 2 uses still_energy); converted to float only for logs
+  decision_t z = this->calculate_z_score(energy, this->mu_still_, this->sigma_still_);
 
   // Log the z-score for debugging
-  ESP_LOGVV(TAG, "Energy=%.2f, z_still=%.2f, state=%d", energy, z_still, this->current_state_);
+  ESP_LOGVV(TAG, "Energy=%.2f, z_still=%.2f, state=%d", DecisionMath::to_float(energy), DecisionMath::to_float(z),
+            this->current_state_);
 
   unsigned long now = millis();
+  const EngineProfile &profile = this->profiles_.active();  // One consistent parameter set per frame
+  const DecisionThresholds &thresholds = this->decision_thresholds(profile);
+  const decision_t k_on = thresholds.k_on;
+  const decision_t k_off = thresholds.k_off;
+  bool was_on = this->state;
+
+  this->update_occupancy_probability(z, now, profile);
 
   // Phase 2 Logic: 4-state machine with debouncing
   switch (this->current_state_) {
     case IDLE:
-      if (z_still >= this->k_on_) {
+      if (z >= k_on) {
         this->debounce_start_time_ = now;
         this->current_state_ = DEBOUNCING_ON;
-        ESP_LOGD(TAG, "IDLE → DEBOUNCING_ON (z=%.2f >= k_on=%.2f)", z_still, this->k_on_);
+        ESP_LOGD(TAG, "IDLE → DEBOUNCING_ON (z=%.2f >= k_on=%.2f)", DecisionMath::to_float(z), profile.k_on);
       }
       break;
 
     case DEBOUNCING_ON:
-      if (z_still >= this->k_on_) {
+      if (z >= k_on) {
         // Condition still holds, check timer
-        if ((now - this->debounce_start_time_) >= this->on_debounce_ms_) {
+        if ((now - this->debounce_start_time_) >= profile.on_debounce_ms) {
           this->current_state_ = PRESENT;
           this->last_high_confidence_time_ = now;
           this->publish_state(true);
 
           char reason[64];
-          snprintf(reason, sizeof(reason), "ON: z=%.2f, debounced %lums", z_still, this->on_debounce_ms_);
+          snprintf(reason, sizeof(reason), "ON: z=%.2f, debounced %lums", DecisionMath::to_float(z),
+                   profile.on_debounce_ms);
           this->publish_reason(reason);
           this->publish_change_reason("on:threshold_exceeded");
 
@@ -102,50 +301,201 @@ void BedPresenceEngine::process_energy_reading(float energy) {
       } else {
         // Condition lost, abort debounce
         this->current_state_ = IDLE;
-        ESP_LOGD(TAG, "DEBOUNCING_ON → IDLE (z=%.2f < k_on, abort)", z_still);
+        ESP_LOGD(TAG, "DEBOUNCING_ON → IDLE (z=%.2f < k_on, abort)", DecisionMath::to_float(z));
       }
       break;
 
     case PRESENT:
       // Update high confidence timestamp whenever strong signal detected
-      if (z_still > this->k_on_) {
+      if (z > k_on) {
         this->last_high_confidence_time_ = now;
       }
 
       // Check for transition to DEBOUNCING_OFF
-      if (z_still < this->k_off_) {
+      if (z < k_off) {
         // Low signal detected, check absolute clear delay
-        if ((now - this->last_high_confidence_time_) >= this->abs_clear_delay_ms_) {
+        if ((now - this->last_high_confidence_time_) >= profile.abs_clear_delay_ms) {
           this->debounce_start_time_ = now;
           this->current_state_ = DEBOUNCING_OFF;
           ESP_LOGD(TAG, "PRESENT → DEBOUNCING_OFF (z=%.2f < k_off, abs_clear=%lums ago)",
-                   z_still, (now - this->last_high_confidence_time_));
+                   DecisionMath::to_float(z), (now - this->last_high_confidence_time_));
         }
       }
       break;
 
     case DEBOUNCING_OFF:
-      if (z_still < this->k_off_) {
+      if (z < k_off) {
         // Condition still holds, check timer
-        if ((now - this->debounce_start_time_) >= this->off_debounce_ms_) {
+        if ((now - this->debounce_start_time_) >= profile.off_debounce_ms) {
           this->current_state_ = IDLE;
           this->publish_state(false);
 
           char reason[64];
-          snprintf(reason, sizeof(reason), "OFF: z=%.2f, debounced %lums", z_still, this->off_debounce_ms_);
+          snprintf(reason, sizeof(reason), "OFF: z=%.2f, debounced %lums", DecisionMath::to_float(z),
+                   profile.off_debounce_ms);
           this->publish_reason(reason);
           this->publish_change_reason("off:abs_clear_delay");
 
           ESP_LOGI(TAG, "DEBOUNCING_OFF → IDLE: %s", reason);
         }
-      } else if (z_still >= this->k_on_) {
+      } else if (z >= k_on) {
         // High signal returned, abort debounce
         this->current_state_ = PRESENT;
         this->last_high_confidence_time_ = now;
-        ESP_LOGD(TAG, "DEBOUNCING_OFF → PRESENT (z=%.2f >= k_on, signal returned)", z_still);
+        ESP_LOGD(TAG, "DEBOUNCING_OFF → PRESENT (z=%.2f >= k_on, signal returned)", DecisionMath::to_float(z));
       }
       break;
   }
+
+  this->record_black_box(now, z);
+  if (this->state != was_on) {
+    // Keep the minutes leading up to the last ON and the last OFF decision, each in its own slot
+    this->black_box_.freeze(now, this->state ? BLACK_BOX_FROZEN_ON : BLACK_BOX_FROZEN_OFF);
+    this->publish_black_box_status("frozen");
+  }
+}
+
+void BedPresenceEngine::record_black_box(unsigned long now, decision_t z) {
+  bool debouncing = this->current_state_ == DEBOUNCING_ON || this->current_state_ == DEBOUNCING_OFF;
+  uint32_t debounce_ms = debouncing ? now - this->debounce_start_time_ : 0;
+  this->black_box_.record(now, DecisionMath::to_centi(z), this->current_state_, this->frame_gate_, debounce_ms,
+                          now - this->last_high_confidence_time_);
+}
+
+void BedPresenceEngine::publish_black_box_status(const char *prefix) {
+  // Describes the newest snapshot; the other slots are listed by black_box_dump
+  BlackBoxFreezeReason reason = this->black_box_.latest_frozen();
+  if (reason == BLACK_BOX_NOT_FROZEN) {
+    return;
+  }
+  char status[64];
+  snprintf(status, sizeof(status), "%s:%s n=%u t=%lus boot=%u", prefix, black_box_reason_name(reason),
+           static_cast<unsigned>(this->black_box_.frozen_size(reason)),
+           static_cast<unsigned long>(this->black_box_.frozen_at_ms(reason) / 1000),
+           static_cast<unsigned>(this->black_box_.frozen_boot(reason)));
+  ESP_LOGD(TAG, "Black box %s", status);
+  if (this->black_box_status_sensor_ != nullptr) {
+    this->black_box_status_sensor_->publish_state(status);
+  }
+}
+
+void BedPresenceEngine::freeze_black_box() {
+  size_t count = this->black_box_.freeze(millis(), BLACK_BOX_FROZEN_MANUAL);
+  ESP_LOGI(TAG, "Black box frozen on demand (%u records)", static_cast<unsigned>(count));
+  this->publish_black_box_status("frozen");
+}
+
+void BedPresenceEngine::dump_black_box(bool frozen) {
+  if (!frozen) {
+    size_t count = this->black_box_.live_size();
+    ESP_LOGI(TAG, "Black box (live, boot #%u, %u records):", static_cast<unsigned>(this->black_box_.boot_count()),
+             static_cast<unsigned>(count));
+    for (size_t i = 0; i < count; ++i) {
+      log_black_box_record(i, this->black_box_.live(i));
+    }
+    return;
+  }
+
+  // Every non-empty snapshot slot: last ON, last OFF, last manual freeze
+  for (auto reason : {BLACK_BOX_FROZEN_ON, BLACK_BOX_FROZEN_OFF, BLACK_BOX_FROZEN_MANUAL}) {
+    size_t count = this->black_box_.frozen_size(reason);
+    if (count == 0) {
+      continue;
+    }
+    ESP_LOGI(TAG, "Black box (frozen: %s at %lums, boot #%u, %u records):", black_box_reason_name(reason),
+             static_cast<unsigned long>(this->black_box_.frozen_at_ms(reason)),
+             static_cast<unsigned>(this->black_box_.frozen_boot(reason)), static_cast<unsigned>(count));
+    for (size_t i = 0; i < count; ++i) {
+      log_black_box_record(i, this->black_box_.frozen(reason, i));
+    }
+  }
+}
+
+void BedPresenceEngine::configure_occupancy_model(const EngineProfile &profile) {
+  // Class statistics in z units: calibration histograms when available, otherwise the
+  // thresholds (empty bed ~ N(0, 1) by construction; occupied centred one hysteresis band above k_on)
+  float mu = DecisionMath::to_float(this->mu_still_);
+  float sigma = DecisionMath::to_float(this->sigma_still_);
+  float empty_mean = 0.0f;
+  float empty_sd = 1.0f;
+  if (!this->empty_histogram_.empty()) {
+    empty_mean = (this->empty_histogram_.mean() - mu) / sigma;
+    empty_sd = this->empty_histogram_.stddev() / sigma;
+  }
+
+  float occupied_mean = 2.0f * profile.k_on - profile.k_off;
+  float occupied_sd = 0.5f * (profile.k_on - profile.k_off);
+  if (!this->occupied_histogram_.empty()) {
+    occupied_mean = (this->occupied_histogram_.mean() - mu) / sigma;
+    occupied_sd = this->occupied_histogram_.stddev() / sigma;
+  }
+
+  this->occupancy_hmm_.set_emissions(empty_mean, empty_sd, occupied_mean, occupied_sd);
+  this->occupancy_model_generation_ = this->profiles_.generation();
+  this->occupancy_model_stale_ = false;
+  ESP_LOGD(TAG, "Occupancy model: empty z~N(%.2f, %.2f), occupied z~N(%.2f, %.2f)", empty_mean, empty_sd,
+           occupied_mean, occupied_sd);
+}
+
+void BedPresenceEngine::update_occupancy_probability(decision_t z, unsigned long now, const EngineProfile &profile) {
+  if (this->occupancy_probability_sensor_ == nullptr || this->sigma_still_ <= DecisionMath::SIGMA_EPSILON) {
+    return;
+  }
+  if (this->occupancy_model_stale_ || this->occupancy_model_generation_ != this->profiles_.generation()) {
+    this->configure_occupancy_model(profile);
+  }
+
+  uint32_t dt = this->occupancy_started_ ? static_cast<uint32_t>(now - this->occupancy_last_update_) : 1000;
+  this->occupancy_started_ = true;
+  this->occupancy_last_update_ = now;
+
+  int moving = -1;
+  if (this->moving_energy_sensor_ != nullptr && this->moving_energy_sensor_->has_state()) {
+    moving = this->moving_energy_sensor_->state >= this->session_tracker_.restless_threshold() ? 1 : 0;
+  }
+  float probability = this->occupancy_hmm_.update(DecisionMath::to_float(z), moving, dt);
+
+  // Publish on meaningful change only; the filter itself runs every frame
+  if (std::fabs(probability - this->occupancy_published_) >= 0.01f) {
+    this->occupancy_published_ = probability;
+    this->occupancy_probability_sensor_->publish_state(probability);
+  }
+}
+
+void BedPresenceEngine::publish_session_summary() {
+  const SessionSummary &session = this->session_tracker_.last();
+  // No wall clock on the device: the start is minutes before this publish, which HA timestamps
+  char summary[112];
+  snprintf(summary, sizeof(summary), "started=%um_ago span=%um in_bed=%um exits=%u restless=%um",
+           static_cast<unsigned>((millis() - session.start_ms) / 60000), static_cast<unsigned>(session.span_s / 60),
+           static_cast<unsigned>(session.in_bed_s / 60), static_cast<unsigned>(session.exits),
+           static_cast<unsigned>(session.restless_min));
+  ESP_LOGI(TAG, "Sleep session closed: %s", summary);
+
+  if (this->session_summary_sensor_ != nullptr) {
+    this->session_summary_sensor_->publish_state(summary);
+  }
+}
+
+void BedPresenceEngine::publish_session_history() {
+  // Newest first, "started_ago/span/in_bed/exits/restless" per session in minutes, ages relative to this publish
+  uint32_t now = millis();
+  std::string history;
+  for (size_t i = 0; i < this->session_tracker_.history_size(); ++i) {
+    const SessionSummary &session = this->session_tracker_.history(i);
+    char entry[64];
+    snprintf(entry, sizeof(entry), "%s%u/%u/%u/%u/%u", i == 0 ? "" : ";",
+             static_cast<unsigned>((now - session.start_ms) / 60000), static_cast<unsigned>(session.span_s / 60),
+             static_cast<unsigned>(session.in_bed_s / 60), static_cast<unsigned>(session.exits),
+             static_cast<unsigned>(session.restless_min));
+    history += entry;
+  }
+  ESP_LOGI(TAG, "Session history (%u): %s", static_cast<unsigned>(this->session_tracker_.history_size()),
+           history.c_str());
+
+  if (this->session_history_sensor_ != nullptr) {
+    this->session_history_sensor_->publish_state(history);
+  }
 }
 
 void BedPresenceEngine::publish_reason(const std::string &reason) {
@@ -160,81 +510,191 @@ void BedPresenceEngine::publish_change_reason(const std::string &reason) {
   }
 }
 
+EngineProfile &BedPresenceEngine::stage_edit() {
+  this->pending_rejection_reported_ = false;
+  return this->profiles_.edit();
+}
+
 void BedPresenceEngine::update_k_on(float k) {
-  ESP_LOGI(TAG, "Updating k_on: %.2f -> %.2f", this->k_on_, k);
-  this->k_on_ = k;
+  ESP_LOGI(TAG, "Staging k_on: %.2f -> %.2f", this->profiles_.active().k_on, k);
+  this->stage_edit().k_on = k;
 }
 
 void BedPresenceEngine::update_k_off(float k) {
-  ESP_LOGI(TAG, "Updating k_off: %.2f -> %.2f", this->k_off_, k);
-  this->k_off_ = k;
+  ESP_LOGI(TAG, "Staging k_off: %.2f -> %.2f", this->profiles_.active().k_off, k);
+  this->stage_edit().k_off = k;
 }
 
 void BedPresenceEngine::update_on_debounce_ms(unsigned long ms) {
-  ESP_LOGI(TAG, "Updating on_debounce_ms: %lu -> %lu", this->on_debounce_ms_, ms);
-  this->on_debounce_ms_ = ms;
+  ESP_LOGI(TAG, "Staging on_debounce_ms: %lu -> %lu", this->profiles_.active().on_debounce_ms, ms);
+  this->stage_edit().on_debounce_ms = ms;
 }
 
 void BedPresenceEngine::update_off_debounce_ms(unsigned long ms) {
-  ESP_LOGI(TAG, "Updating off_debounce_ms: %lu -> %lu", this->off_debounce_ms_, ms);
-  this->off_debounce_ms_ = ms;
+  ESP_LOGI(TAG, "Staging off_debounce_ms: %lu -> %lu", this->profiles_.active().off_debounce_ms, ms);
+  this->stage_edit().off_debounce_ms = ms;
 }
 
 void BedPresenceEngine::update_abs_clear_delay_ms(unsigned long ms) {
-  ESP_LOGI(TAG, "Updating abs_clear_delay_ms: %lu -> %lu", this->abs_clear_delay_ms_, ms);
-  this->abs_clear_delay_ms_ = ms;
+  ESP_LOGI(TAG, "Staging abs_clear_delay_ms: %lu -> %lu", this->profiles_.active().abs_clear_delay_ms, ms);
+  this->stage_edit().abs_clear_delay_ms = ms;
 }
 
 void BedPresenceEngine::update_d_min_cm(float value) {
-  ESP_LOGI(TAG, "Updating d_min_cm: %.1f -> %.1f", this->d_min_cm_, value);
-  this->d_min_cm_ = value;
+  ESP_LOGI(TAG, "Staging d_min_cm: %.1f -> %.1f", this->profiles_.active().d_min_cm, value);
+  this->stage_edit().d_min_cm = value;
 }
 
 void BedPresenceEngine::update_d_max_cm(float value) {
-  ESP_LOGI(TAG, "Updating d_max_cm: %.1f -> %.1f", this->d_max_cm_, value);
-  this->d_max_cm_ = value;
+  ESP_LOGI(TAG, "Staging d_max_cm: %.1f -> %.1f", this->profiles_.active().d_max_cm, value);
+  this->stage_edit().d_max_cm = value;
 }
 
-void BedPresenceEngine::start_baseline_calibration(uint32_t duration_s) {
+void BedPresenceEngine::commit_pending_profile() {
+  const char *reason;
+  switch (this->profiles_.commit_pending(&reason)) {
+    case ProfileStore::COMMIT_APPLIED: {
+      const EngineProfile &profile = this->profiles_.active();
+      ESP_LOGI(TAG, "Applied custom profile: k_on=%.2f, k_off=%.2f, on=%lums, off=%lums, abs_clear=%lums, "
+               "window=[%.1fcm, %.1fcm]", profile.k_on, profile.k_off, profile.on_debounce_ms,
+               profile.off_debounce_ms, profile.abs_clear_delay_ms, profile.d_min_cm, profile.d_max_cm);
+      this->publish_change_reason("profile:custom");
+      break;
+    }
+    case ProfileStore::COMMIT_REJECTED:
+      // Keep running the previous profile until the staged knobs become consistent
+      if (!this->pending_rejection_reported_) {
+        this->pending_rejection_reported_ = true;
+        ESP_LOGW(TAG, "Holding staged parameters, profile invalid: %s", reason);
+        this->publish_change_reason(std::string("profile:rejected:") + reason);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void BedPresenceEngine::add_profile(const char *name, float k_on, float k_off, unsigned long on_debounce_ms,
+                                    unsigned long off_debounce_ms, unsigned long abs_clear_delay_ms, float d_min_cm,
+                                    float d_max_cm) {
+  EngineProfile profile;
+  profile.name = name;
+  profile.k_on = k_on;
+  profile.k_off = k_off;
+  profile.on_debounce_ms = on_debounce_ms;
+  profile.off_debounce_ms = off_debounce_ms;
+  profile.abs_clear_delay_ms = abs_clear_delay_ms;
+  profile.d_min_cm = d_min_cm;
+  profile.d_max_cm = d_max_cm;
+
+  const char *reason = this->profiles_.add_preset(profile);
+  if (reason != nullptr) {
+    ESP_LOGE(TAG, "Rejected profile '%s': %s", name, reason);
+  }
+}
+
+bool BedPresenceEngine::select_profile(const std::string &name) {
+  if (!this->profiles_.select(name.c_str())) {
+    ESP_LOGW(TAG, "Unknown or invalid profile '%s'", name.c_str());
+    return false;
+  }
+
+  const EngineProfile &profile = this->profiles_.active();
+  ESP_LOGI(TAG, "Switched to profile '%s': k_on=%.2f, k_off=%.2f", profile.name, profile.k_on, profile.k_off);
+  this->publish_change_reason("profile:" + name);
+  return true;
+}
+
+bool BedPresenceEngine::begin_calibration(CalibrationPhase phase, uint32_t duration_s) {
   if (duration_s == 0) {
     ESP_LOGW(TAG, "Ignoring calibration request with 0s duration");
-    return;
+    return false;
+  }
+  if (this->calibration_phase_ != CALIBRATION_NONE) {
+    ESP_LOGW(TAG, "Discarding calibration in progress and restarting");
   }
 
   uint32_t clamped = std::min<uint32_t>(duration_s, 600);  // Hard cap at 10 minutes
-  this->calibrating_ = true;
-  this->calibration_samples_.clear();
-  size_t expected_samples = static_cast<size_t>(clamped) * 50;  // assume up to 50 frames/sec
-  this->calibration_samples_.reserve(std::min(expected_samples, MAX_CALIBRATION_SAMPLES));
-  this->calibration_end_time_ = millis() + clamped * 1000UL;
+  unsigned long now = millis();
+  this->calibration_phase_ = phase;
+  this->calibration_end_time_ = now + clamped * 1000UL;
+  this->calibration_duration_s_ = clamped;
+  this->calibration_retries_left_ = this->calibration_max_retries_;
+  this->calibration_histogram_.clear();
+  this->calibration_quality_.start(now, clamped * 1000UL);
+  return true;
+}
+
+void BedPresenceEngine::start_baseline_calibration(uint32_t duration_s) {
+  if (!this->begin_calibration(CALIBRATION_BASELINE, duration_s)) {
+    return;
+  }
 
+  uint32_t clamped = std::min<uint32_t>(duration_s, 600);
   ESP_LOGI(TAG, "Starting baseline calibration for %us (collecting samples within distance window)", clamped);
   this->publish_reason("Calibration started");
   this->publish_change_reason("calibration:started");
 }
 
+void BedPresenceEngine::start_occupied_calibration(uint32_t duration_s) {
+  if (this->empty_histogram_.empty()) {
+    ESP_LOGW(TAG, "Occupied calibration requires a completed baseline calibration first");
+    this->publish_reason("Occupied calibration failed: run baseline first");
+    this->publish_change_reason("calibration:baseline_required");
+    return;
+  }
+  if (!this->begin_calibration(CALIBRATION_OCCUPIED, duration_s)) {
+    return;
+  }
+
+  ESP_LOGI(TAG, "Starting occupied-bed calibration for %us", std::min<uint32_t>(duration_s, 600));
+  this->publish_reason("Occupied calibration started");
+  this->publish_change_reason("calibration:occupied_started");
+}
+
 void BedPresenceEngine::stop_baseline_calibration() {
-  if (!this->calibrating_) {
+  if (this->calibration_phase_ == CALIBRATION_NONE) {
     ESP_LOGW(TAG, "Calibration stop requested, but no calibration in progress");
     return;
   }
-  this->finalize_calibration();
+  this->finalize_calibration(false);  // Explicit stop: evaluate what we have, never auto-retry
+}
+
+bool BedPresenceEngine::apply_suggested_thresholds() {
+  if (!this->threshold_suggestion_.valid) {
+    ESP_LOGW(TAG, "No valid threshold suggestion to apply");
+    return false;
+  }
+
+  EngineProfile candidate = this->profiles_.active();
+  candidate.name = "custom";
+  candidate.k_on = this->threshold_suggestion_.k_on;
+  candidate.k_off = this->threshold_suggestion_.k_off;
+  const char *reason = this->profiles_.install(candidate);
+  if (reason != nullptr) {
+    ESP_LOGW(TAG, "Suggested thresholds rejected: %s", reason);
+    return false;
+  }
+
+  ESP_LOGI(TAG, "Applied suggested thresholds: k_on=%.2f, k_off=%.2f", candidate.k_on, candidate.k_off);
+  this->publish_change_reason("calibration:thresholds_applied");
+  return true;
 }
 
 void BedPresenceEngine::reset_to_defaults() {
   ESP_LOGI(TAG, "Resetting engine parameters to known-good defaults");
-  this->mu_still_ = 6.7f;
-  this->sigma_still_ = 3.5f;
-  this->k_on_ = 9.0f;
-  this->k_off_ = 4.0f;
-  this->on_debounce_ms_ = 3000;
-  this->off_debounce_ms_ = 5000;
-  this->abs_clear_delay_ms_ = 30000;
-  this->d_min_cm_ = 0.0f;
-  this->d_max_cm_ = 600.0f;
-
-  this->calibrating_ = false;
-  this->calibration_samples_.clear();
+  this->mu_still_ = DecisionMath::from_float(6.7f);
+  this->sigma_still_ = DecisionMath::from_float(3.5f);
+  this->profiles_.install(EngineProfile());  // Known-good defaults, applied as one profile
+
+  this->calibration_phase_ = CALIBRATION_NONE;
+  this->calibration_histogram_.clear();
+  this->empty_histogram_.clear();
+  this->occupied_histogram_.clear();
+  this->threshold_suggestion_ = ThresholdSuggestion();
+  this->occupancy_model_stale_ = true;
+  this->thresholds_stale_ = true;
+  this->occupancy_hmm_.reset();
 
   this->current_state_ = IDLE;
   this->publish_state(false);
@@ -243,81 +703,180 @@ void BedPresenceEngine::reset_to_defaults() {
 }
 
 void BedPresenceEngine::handle_calibration_sample(float energy) {
-  if (!this->calibrating_) {
-    return;
-  }
-
-  if (this->calibration_samples_.size() >= MAX_CALIBRATION_SAMPLES) {
-    ESP_LOGW(TAG, "Calibration sample buffer full (%u samples), finalizing early",
-             static_cast<unsigned>(this->calibration_samples_.size()));
-    this->finalize_calibration();
+  if (this->calibration_phase_ == CALIBRATION_NONE) {
     return;
   }
 
-  this->calibration_samples_.push_back(energy);
+  this->calibration_quality_.add_sample(millis(), energy);
+  this->calibration_histogram_.add(energy);
 
   if (millis() >= this->calibration_end_time_) {
     this->finalize_calibration();
   }
 }
 
-static float compute_median(std::vector<float> values) {
-  if (values.empty()) {
-    return 0.0f;
-  }
-
-  size_t mid = values.size() / 2;
-  std::nth_element(values.begin(), values.begin() + mid, values.end());
-  float median = values[mid];
+void BedPresenceEngine::finalize_calibration(bool allow_retry) {
+  CalibrationPhase phase = this->calibration_phase_;
+  this->calibration_phase_ = CALIBRATION_NONE;
 
-  if (values.size() % 2 == 0) {
-    std::nth_element(values.begin(), values.begin() + mid - 1, values.end());
-    median = (median + values[mid - 1]) / 2.0f;
+  if (phase == CALIBRATION_BASELINE) {
+    this->finalize_baseline_calibration(allow_retry);
+  } else if (phase == CALIBRATION_OCCUPIED) {
+    this->finalize_occupied_calibration(allow_retry);
   }
-  return median;
 }
 
-void BedPresenceEngine::finalize_calibration() {
-  if (!this->calibrating_) {
-    return;
+bool BedPresenceEngine::check_calibration_quality(CalibrationPhase phase, const CalibrationQualityReport &report,
+                                                  bool allow_retry) {
+  ESP_LOGI(TAG, "Calibration quality %.0f: drift=%.2fσ, outliers=%.1f%%, loop=%.2fHz, rejected=%.1f%%", report.score,
+           report.drift_sigma, report.outlier_fraction * 100.0f, report.loop_rate_hz,
+           report.rejection_rate * 100.0f);
+  if (this->calibration_quality_sensor_ != nullptr) {
+    this->calibration_quality_sensor_->publish_state(report.score);
+  }
+  if (report.failure == nullptr) {
+    return true;
   }
 
-  this->calibrating_ = false;
+  if (allow_retry && report.retryable() && this->calibration_retries_left_ > 0) {
+    uint8_t retries_left = this->calibration_retries_left_ - 1;
+    ESP_LOGW(TAG, "Calibration session failed quality check (%s), retrying for %us", report.failure,
+             static_cast<unsigned>(this->calibration_duration_s_));
+    if (phase == CALIBRATION_BASELINE) {
+      this->start_baseline_calibration(this->calibration_duration_s_);
+    } else {
+      this->start_occupied_calibration(this->calibration_duration_s_);
+    }
+    this->calibration_retries_left_ = retries_left;
+    this->publish_change_reason(std::string("calibration:retrying:") + report.failure);
+    return false;
+  }
 
-  if (this->calibration_samples_.empty()) {
+  // Keep the previous statistics: a bad session must never replace a good one
+  ESP_LOGW(TAG, "Calibration rejected (%s), keeping previous parameters", report.failure);
+  char summary[96];
+  snprintf(summary, sizeof(summary), "Calibration rejected: %s (quality=%.0f)", report.failure, report.score);
+  this->publish_reason(summary);
+  this->publish_change_reason(std::string("calibration:rejected:") + report.failure);
+  return false;
+}
+
+void BedPresenceEngine::finalize_baseline_calibration(bool allow_retry) {
+  size_t count = this->calibration_histogram_.total;
+  if (count == 0) {
     ESP_LOGW(TAG, "Calibration finished with no samples collected");
     this->publish_reason("Calibration failed: no samples");
     this->publish_change_reason("calibration:insufficient_samples");
     return;
   }
 
-  auto samples = this->calibration_samples_;
-  this->calibration_samples_.clear();
+  // Streaming: exact median/MAD of the session histogram, no sample buffer and no length cap
+  decision_t mu_value = DecisionMath::histogram_median(this->calibration_histogram_);
+  decision_t sigma_value = DecisionMath::histogram_sigma(this->calibration_histogram_);
+  float median = DecisionMath::to_float(mu_value);
+  float sigma = DecisionMath::to_float(sigma_value);
 
-  float median = compute_median(samples);
-  std::vector<float> deviations(samples.size());
-  for (size_t i = 0; i < samples.size(); ++i) {
-    deviations[i] = std::fabs(samples[i] - median);
-  }
-  float mad = compute_median(deviations);
-  float sigma = mad * 1.4826f;
-  if (sigma < 0.05f) {
-    sigma = 0.05f;
+  CalibrationQualityReport report = this->calibration_quality_.evaluate(millis(), this->calibration_histogram_, median,
+                                                                        sigma, this->calibration_limits_);
+  if (!this->check_calibration_quality(CALIBRATION_BASELINE, report, allow_retry)) {
+    return;
   }
 
-  this->mu_still_ = median;
-  this->sigma_still_ = sigma;
+  this->empty_histogram_ = this->calibration_histogram_;
+  this->mu_still_ = mu_value;
+  this->sigma_still_ = sigma_value;
+  this->occupancy_model_stale_ = true;  // Rebuild emissions against the new baseline
+  this->thresholds_stale_ = true;       // The cadence wake energy is relative to it
 
   ESP_LOGI(TAG, "Calibration complete: mu=%.2f, sigma=%.2f (samples=%u)", median, sigma,
-           static_cast<unsigned>(samples.size()));
+           static_cast<unsigned>(count));
+
+  // A suggestion is in k units of the baseline it was derived against: re-derive it, or drop it
+  if (!this->occupied_histogram_.empty()) {
+    const ThresholdSuggestion &suggestion = this->update_threshold_suggestion();
+    ESP_LOGI(TAG, "Threshold suggestion re-derived for the new baseline: %s k_on=%.2f, k_off=%.2f, margin=%.2f",
+             suggestion.valid ? "valid" : "invalid", suggestion.k_on, suggestion.k_off, suggestion.margin);
+  } else {
+    this->threshold_suggestion_ = ThresholdSuggestion();
+  }
 
   char summary[96];
-  snprintf(summary, sizeof(summary), "Calibration complete: μ=%.2f, σ=%.2f, n=%u", median, sigma,
-           static_cast<unsigned>(samples.size()));
+  snprintf(summary, sizeof(summary), "Calibration complete: μ=%.2f, σ=%.2f, n=%u, quality=%.0f", median, sigma,
+           static_cast<unsigned>(count), report.score);
   this->publish_reason(summary);
   this->publish_change_reason("calibration:completed");
 }
 
+void BedPresenceEngine::finalize_occupied_calibration(bool allow_retry) {
+  if (this->calibration_histogram_.empty()) {
+    ESP_LOGW(TAG, "Occupied calibration finished with no samples collected");
+    this->publish_reason("Occupied calibration failed: no samples");
+    this->publish_change_reason("calibration:insufficient_samples");
+    return;
+  }
+
+  // Scoring only (float in both builds); the histogram itself is what later feeds the suggestion
+  float center = FloatMath::histogram_median(this->calibration_histogram_);
+  float sigma = FloatMath::histogram_sigma(this->calibration_histogram_);
+  CalibrationQualityReport report = this->calibration_quality_.evaluate(millis(), this->calibration_histogram_, center,
+                                                                        sigma, this->calibration_limits_);
+  if (!this->check_calibration_quality(CALIBRATION_OCCUPIED, report, allow_retry)) {
+    return;
+  }
+  this->occupied_histogram_ = this->calibration_histogram_;
+  this->occupancy_model_stale_ = true;  // Occupied-class emissions now come from the histogram
+  const ThresholdSuggestion &suggestion = this->update_threshold_suggestion();
+
+  ESP_LOGI(TAG, "Occupied calibration: empty p%.1f=%d, occupied p%.1f=%d, margin=%.2f (n=%u)",
+           (1.0f - this->target_false_on_rate_) * 100.0f, suggestion.empty_upper, this->target_false_off_rate_ * 100.0f,
+           suggestion.occupied_lower, suggestion.margin, static_cast<unsigned>(this->occupied_histogram_.total));
+
+  char summary[96];
+  if (!suggestion.valid && suggestion.margin <= 0.0f) {
+    snprintf(summary, sizeof(summary), "Occupied calibration: classes overlap (margin=%.2f)", suggestion.margin);
+    this->publish_reason(summary);
+    this->publish_change_reason("calibration:classes_overlap");
+    return;
+  }
+  if (!suggestion.valid) {
+    // Separated, but not within k ∈ [0, K_MAX] of this baseline: the baseline does not describe this empty bed
+    ESP_LOGW(TAG, "Class gap lies outside k ∈ [0, %.1f] of the baseline, recalibrate the baseline",
+             EngineProfile::K_MAX);
+    snprintf(summary, sizeof(summary), "Occupied calibration: gap outside k range (margin=%.2f)", suggestion.margin);
+    this->publish_reason(summary);
+    this->publish_change_reason("calibration:thresholds_out_of_range");
+    return;
+  }
+  if (suggestion.clamped) {
+    ESP_LOGI(TAG, "Thresholds placed within the reachable range k ∈ [0, %.1f]", EngineProfile::K_MAX);
+  }
+
+  snprintf(summary, sizeof(summary), "Suggested k_on=%.2f, k_off=%.2f, margin=%.2f", suggestion.k_on,
+           suggestion.k_off, suggestion.margin);
+  this->publish_reason(summary);
+  this->publish_change_reason("calibration:thresholds_suggested");
+}
+
+const ThresholdSuggestion &BedPresenceEngine::update_threshold_suggestion() {
+  // Both class histograms against the current baseline; sensors always describe the suggestion apply would use
+  this->threshold_suggestion_ =
+      derive_thresholds(this->empty_histogram_, this->occupied_histogram_, DecisionMath::to_float(this->mu_still_),
+                        DecisionMath::to_float(this->sigma_still_), this->target_false_on_rate_,
+                        this->target_false_off_rate_, EngineProfile::K_MAX);
+  const ThresholdSuggestion &suggestion = this->threshold_suggestion_;
+
+  if (this->separation_margin_sensor_ != nullptr) {
+    this->separation_margin_sensor_->publish_state(suggestion.margin);
+  }
+  // An invalid suggestion clears a previously published one (unknown) rather than leaving it displayed
+  if (this->suggested_k_on_sensor_ != nullptr && (suggestion.valid || this->suggested_k_on_sensor_->has_state())) {
+    this->suggested_k_on_sensor_->publish_state(suggestion.valid ? suggestion.k_on : NAN);
+  }
+  if (this->suggested_k_off_sensor_ != nullptr && (suggestion.valid || this->suggested_k_off_sensor_->has_state())) {
+    this->suggested_k_off_sensor_->publish_state(suggestion.valid ? suggestion.k_off : NAN);
+  }
+  return suggestion;
+}
 
 }  // namespace bed_presence_engine
 }  // namespace esphome
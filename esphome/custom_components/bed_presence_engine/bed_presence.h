@@ -4,8 +4,15 @@
 #include "esphome/components/binary_sensor/binary_sensor.h"
 #include "esphome/components/sensor/sensor.h"
 #include "esphome/components/text_sensor/text_sensor.h"
+#include "black_box.h"
+#include "cadence_controller.h"
+#include "calibration_quality.h"
+#include "energy_histogram.h"
+#include "engine_profile.h"
+#include "fixed_point.h"
+#include "occupancy_hmm.h"
+#include "sleep_session.h"
 #include <string>
-#include <vector>
 
 namespace esphome {
 namespace bed_presence_engine {
@@ -18,6 +25,20 @@ enum State {
   DEBOUNCING_OFF  // Low signal detected, timer running (binary sensor: ON)
 };
 
+// Phase 3: How frames outside [d_min_cm, d_max_cm] reach the state machine
+enum DistanceGateMode {
+  GATE_HARD,           // Drop the frame entirely (state machine sees nothing)
+  GATE_ZERO_EVIDENCE,  // Process the frame as baseline energy (z = 0)
+  GATE_SOFT            // Scale energy above baseline by a smooth distance membership
+};
+
+// Calibration phases (one active at a time)
+enum CalibrationPhase {
+  CALIBRATION_NONE,
+  CALIBRATION_BASELINE,  // Empty bed: learns μ/σ via MAD
+  CALIBRATION_OCCUPIED   // Occupied bed: derives k_on/k_off against the empty-bed distribution
+};
+
 /**
  * BedPresenceEngine Component - Phase 2 Implementation
  *
@@ -36,18 +57,51 @@ class BedPresenceEngine : public Component, public binary_sensor::BinarySensor {
 
   // Configuration setters
   void set_energy_sensor(sensor::Sensor *sensor) { energy_sensor_ = sensor; }
-  void set_k_on(float k) { k_on_ = k; }
-  void set_k_off(float k) { k_off_ = k; }
-  void set_on_debounce_ms(unsigned long ms) { on_debounce_ms_ = ms; }
-  void set_off_debounce_ms(unsigned long ms) { off_debounce_ms_ = ms; }
-  void set_abs_clear_delay_ms(unsigned long ms) { abs_clear_delay_ms_ = ms; }
+  void set_k_on(float k) { profiles_.base().k_on = k; }
+  void set_k_off(float k) { profiles_.base().k_off = k; }
+  void set_on_debounce_ms(unsigned long ms) { profiles_.base().on_debounce_ms = ms; }
+  void set_off_debounce_ms(unsigned long ms) { profiles_.base().off_debounce_ms = ms; }
+  void set_abs_clear_delay_ms(unsigned long ms) { profiles_.base().abs_clear_delay_ms = ms; }
   void set_state_reason_sensor(text_sensor::TextSensor *sensor) { state_reason_sensor_ = sensor; }
   void set_last_change_reason_sensor(text_sensor::TextSensor *sensor) { last_change_reason_sensor_ = sensor; }
   void set_distance_sensor(sensor::Sensor *sensor) { distance_sensor_ = sensor; }
-  void set_d_min_cm(float value) { d_min_cm_ = value; }
-  void set_d_max_cm(float value) { d_max_cm_ = value; }
+  void set_d_min_cm(float value) { profiles_.base().d_min_cm = value; }
+  void set_d_max_cm(float value) { profiles_.base().d_max_cm = value; }
+  void add_profile(const char *name, float k_on, float k_off, unsigned long on_debounce_ms,
+                   unsigned long off_debounce_ms, unsigned long abs_clear_delay_ms, float d_min_cm, float d_max_cm);
+  void set_distance_gate_mode(DistanceGateMode mode) { distance_gate_mode_ = mode; }
+  void set_distance_soft_margin_cm(float value) { distance_soft_margin_cm_ = DecisionMath::from_float(value); }
+  void set_frames_in_window_sensor(sensor::Sensor *sensor) { frames_in_window_sensor_ = sensor; }
+  void set_frames_attenuated_sensor(sensor::Sensor *sensor) { frames_attenuated_sensor_ = sensor; }
+  void set_frames_out_of_window_sensor(sensor::Sensor *sensor) { frames_out_of_window_sensor_ = sensor; }
+  void set_idle_decimation(uint32_t factor) { cadence_.set_decimation(factor); }
+  void set_cadence_wake_margin(float margin) {
+    cadence_wake_margin_ = margin;
+    thresholds_stale_ = true;
+  }
+  void set_frames_processed_sensor(sensor::Sensor *sensor) { frames_processed_sensor_ = sensor; }
+  void set_frames_decimated_sensor(sensor::Sensor *sensor) { frames_decimated_sensor_ = sensor; }
+  void set_moving_energy_sensor(sensor::Sensor *sensor) { moving_energy_sensor_ = sensor; }
+  void set_session_exit_grace_ms(uint32_t ms) { session_tracker_.set_exit_grace_ms(ms); }
+  void set_session_min_duration_ms(uint32_t ms) { session_tracker_.set_min_session_ms(ms); }
+  void set_restless_moving_energy(float energy) { session_tracker_.set_restless_threshold(energy); }
+  void set_session_summary_sensor(text_sensor::TextSensor *sensor) { session_summary_sensor_ = sensor; }
+  void set_session_history_sensor(text_sensor::TextSensor *sensor) { session_history_sensor_ = sensor; }
+  void set_target_false_on_rate(float rate) { target_false_on_rate_ = rate; }
+  void set_target_false_off_rate(float rate) { target_false_off_rate_ = rate; }
+  void set_suggested_k_on_sensor(sensor::Sensor *sensor) { suggested_k_on_sensor_ = sensor; }
+  void set_suggested_k_off_sensor(sensor::Sensor *sensor) { suggested_k_off_sensor_ = sensor; }
+  void set_separation_margin_sensor(sensor::Sensor *sensor) { separation_margin_sensor_ = sensor; }
+  void set_calibration_max_retries(uint8_t retries) { calibration_max_retries_ = retries; }
+  void set_calibration_min_loop_rate(float hz) { calibration_limits_.min_loop_rate_hz = hz; }
+  void set_calibration_quality_sensor(sensor::Sensor *sensor) { calibration_quality_sensor_ = sensor; }
+  void set_black_box_interval_ms(uint32_t ms) { black_box_.set_interval_ms(ms); }
+  void set_black_box_status_sensor(text_sensor::TextSensor *sensor) { black_box_status_sensor_ = sensor; }
+  void set_occupancy_probability_sensor(sensor::Sensor *sensor) { occupancy_probability_sensor_ = sensor; }
+  void set_occupancy_evidence_period_ms(uint32_t ms) { occupancy_hmm_.set_evidence_period_ms(ms); }
 
   // Public methods for runtime updates from HA
+  // Individual knobs are staged and applied together at the next frame once the combination validates
   void update_k_on(float k);
   void update_k_off(float k);
   void update_on_debounce_ms(unsigned long ms);
@@ -56,33 +110,76 @@ class BedPresenceEngine : public Component, public binary_sensor::BinarySensor {
   void update_d_min_cm(float value);
   void update_d_max_cm(float value);
 
+  // Parameter profiles: named presets switched atomically between frames
+  bool select_profile(const std::string &name);
+  const EngineProfile &get_active_profile() const { return profiles_.active(); }
+
   // Calibration + reset services
   void start_baseline_calibration(uint32_t duration_s);
   void stop_baseline_calibration();
+  void start_occupied_calibration(uint32_t duration_s);
+  bool apply_suggested_thresholds();
   void reset_to_defaults();
 
+  // Sleep-session history (bounded ring, fetched on demand)
+  void publish_session_history();
+
+  // Black box: freeze the live recording now / dump a recording to the log
+  void freeze_black_box();
+  void dump_black_box(bool frozen);
+
+  float get_k_on() const { return profiles_.active().k_on; }
+  float get_k_off() const { return profiles_.active().k_off; }
+
  protected:
   // Input sensor
   sensor::Sensor *energy_sensor_{nullptr};
   sensor::Sensor *distance_sensor_{nullptr};
+  sensor::Sensor *moving_energy_sensor_{nullptr};  // Restlessness only, never occupancy
 
   // Baseline calibration collected on 2025-11-06 18:39:42
   // Location: New sensor position looking at bed
   // Conditions: Empty bed, door closed, minimal movement
   // Statistics: mean=6.67%, stdev=3.51%, n=30 samples over 60 seconds
   // Phase 2: Renamed from mu_move_/sigma_move_ for semantic correctness (measures still_energy)
-  float mu_still_{6.7f};    // Mean still energy (empty bed)
-  float sigma_still_{3.5f}; // Std dev still energy (empty bed)
+  // float, or Q format with BED_PRESENCE_FIXED_POINT (see fixed_point.h)
+  decision_t mu_still_{DecisionMath::from_float(6.7f)};    // Mean still energy (empty bed)
+  decision_t sigma_still_{DecisionMath::from_float(3.5f)}; // Std dev still energy (empty bed)
   float mu_stat_{6.7f};     // Reserved for Phase 3 (moving energy fusion)
   float sigma_stat_{3.5f};  // Reserved for Phase 3 (moving energy fusion)
 
-  // Threshold multipliers (k_on > k_off for hysteresis)
-  float k_on_{9.0f};   // Turn ON when z > k_on (default: 9 std deviations)
-  float k_off_{4.0f};  // Turn OFF when z < k_off (default: 4 std deviations)
+  // Thresholds (k_on > k_off for hysteresis), debounce timers and distance window.
+  // Read only through the active profile pointer; see EngineProfile for defaults.
+  ProfileStore profiles_;
+  bool pending_rejection_reported_{false};
 
-  // Phase 3: Distance window (cm)
-  float d_min_cm_{0.0f};
-  float d_max_cm_{600.0f};
+  // Phase 3: Distance gating
+  DistanceGateMode distance_gate_mode_{GATE_HARD};
+  decision_t distance_soft_margin_cm_{DecisionMath::from_float(50.0f)};  // GATE_SOFT: 1 → 0 over this band
+
+  // Gate decision counters (published every DIAGNOSTICS_INTERVAL_MS)
+  uint32_t frames_in_window_{0};
+  uint32_t frames_attenuated_{0};
+  uint32_t frames_out_of_window_{0};
+  unsigned long last_diagnostics_time_{0};
+
+  // Adaptive processing cadence (full rate within one frame of approaching k_on)
+  BasicCadenceController<DecisionMath> cadence_;
+  float cadence_wake_margin_{3.0f};  // z below k_on at which full-rate processing resumes
+
+  // Active profile and cadence wake energy in decision_t, converted once per profile or baseline change
+  struct DecisionThresholds {
+    decision_t k_on;
+    decision_t k_off;
+    decision_t wake_energy;
+    decision_t d_min_cm;
+    decision_t d_max_cm;
+  };
+  DecisionThresholds thresholds_{};
+  uint32_t thresholds_generation_{0};  // Profile generation the thresholds were converted for
+  bool thresholds_stale_{true};        // Baseline or wake margin changed
+
+  static constexpr unsigned long DIAGNOSTICS_INTERVAL_MS = 60000;
 
   // Phase 2: State machine (replaces simple boolean)
   State current_state_{IDLE};
@@ -90,28 +187,81 @@ class BedPresenceEngine : public Component, public binary_sensor::BinarySensor {
   // Phase 2: Debounce timers
   unsigned long debounce_start_time_{0};      // Timestamp when current debounce started
   unsigned long last_high_confidence_time_{0}; // Last time z_still > k_on (while in PRESENT)
-  unsigned long on_debounce_ms_{3000};         // Default: 3 seconds
-  unsigned long off_debounce_ms_{5000};        // Default: 5 seconds
-  unsigned long abs_clear_delay_ms_{30000};    // Default: 30 seconds
 
   // Output sensors
   text_sensor::TextSensor *state_reason_sensor_{nullptr};
   text_sensor::TextSensor *last_change_reason_sensor_{nullptr};
+  sensor::Sensor *frames_in_window_sensor_{nullptr};
+  sensor::Sensor *frames_attenuated_sensor_{nullptr};
+  sensor::Sensor *frames_out_of_window_sensor_{nullptr};
+  sensor::Sensor *frames_processed_sensor_{nullptr};
+  sensor::Sensor *frames_decimated_sensor_{nullptr};
+  text_sensor::TextSensor *session_summary_sensor_{nullptr};
+  text_sensor::TextSensor *session_history_sensor_{nullptr};
+
+  // On-device sleep-session aggregation (one publish per session instead of per frame)
+  SleepSessionTracker session_tracker_;
+
+  // Optional HMM occupancy probability (runs only when its sensor is configured)
+  OccupancyHmm occupancy_hmm_;
+  sensor::Sensor *occupancy_probability_sensor_{nullptr};
+  uint32_t occupancy_model_generation_{0};  // Profile generation the emissions were built for
+  bool occupancy_model_stale_{true};       // Calibration changed the class statistics
+  unsigned long occupancy_last_update_{0};
+  bool occupancy_started_{false};
+  float occupancy_published_{-1.0f};
+
+  // Always-on decision recorder (RTC no-init memory on ESP32, frozen on every ON↔OFF)
+  BlackBox black_box_;
+  BlackBoxGate frame_gate_{BLACK_BOX_IN_WINDOW};
+  text_sensor::TextSensor *black_box_status_sensor_{nullptr};
 
   // Internal methods
-  float calculate_z_score(float energy, float mu, float sigma);
-  void process_energy_reading(float energy);
+  decision_t calculate_z_score(decision_t energy, decision_t mu, decision_t sigma);
+  const DecisionThresholds &decision_thresholds(const EngineProfile &profile);
+  decision_t distance_gate_weight(const DecisionThresholds &thresholds) const;
+  EngineProfile &stage_edit();
+  void commit_pending_profile();
+  void publish_diagnostics();
+  void publish_session_summary();
+  void process_energy_reading(decision_t energy);
+  void record_black_box(unsigned long now, decision_t z);
+  void publish_black_box_status(const char *prefix);
+  void configure_occupancy_model(const EngineProfile &profile);
+  void update_occupancy_probability(decision_t z, unsigned long now, const EngineProfile &profile);
   void publish_reason(const std::string &reason);
   void publish_change_reason(const std::string &reason);
 
   // Calibration helpers
+  bool begin_calibration(CalibrationPhase phase, uint32_t duration_s);
   void handle_calibration_sample(float energy);
-  void finalize_calibration();
+  void finalize_calibration(bool allow_retry = true);
+  void finalize_baseline_calibration(bool allow_retry);
+  void finalize_occupied_calibration(bool allow_retry);
+  const ThresholdSuggestion &update_threshold_suggestion();
+  bool check_calibration_quality(CalibrationPhase phase, const CalibrationQualityReport &report, bool allow_retry);
 
-  bool calibrating_{false};
+  CalibrationPhase calibration_phase_{CALIBRATION_NONE};
   unsigned long calibration_end_time_{0};
-  std::vector<float> calibration_samples_;
-  static constexpr size_t MAX_CALIBRATION_SAMPLES = 4096;
+  // Session quality gating: a bad session is retried (transient problems) or rejected,
+  // never applied, so a polluted baseline cannot inflate σ and slow detection
+  CalibrationQuality calibration_quality_;
+  CalibrationQualityLimits calibration_limits_;
+  EnergyHistogram calibration_histogram_;  // Current session; copied into the class histogram on acceptance
+  uint32_t calibration_duration_s_{0};
+  uint8_t calibration_max_retries_{1};
+  uint8_t calibration_retries_left_{0};
+  sensor::Sensor *calibration_quality_sensor_{nullptr};
+
+  // Two-class calibration: streaming energy distributions per class
+  EnergyHistogram empty_histogram_;
+  EnergyHistogram occupied_histogram_;
+  ThresholdSuggestion threshold_suggestion_;
+  float target_false_on_rate_{0.001f};  // Per-frame rate of empty-bed frames allowed above k_on
+  float target_false_off_rate_{0.01f};  // Per-frame rate of occupied-bed frames allowed below k_off
+  sensor::Sensor *suggested_k_on_sensor_{nullptr};
+  sensor::Sensor *suggested_k_off_sensor_{nullptr};
+  sensor::Sensor *separation_margin_sensor_{nullptr};
 };
 
 }  // namespace bed_presence_engine
@@ -2,7 +2,7 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import sensor, binary_sensor, text_sensor
-from esphome.const import CONF_ID, DEVICE_CLASS_OCCUPANCY
+from esphome.const import CONF_ID, CONF_NAME, DEVICE_CLASS_OCCUPANCY, STATE_CLASS_MEASUREMENT
 
 from . import bed_presence_engine_ns, BedPresenceEngine
 
@@ -18,8 +18,94 @@ CONF_DISTANCE_MIN = "distance_min_cm"
 CONF_DISTANCE_MAX = "distance_max_cm"
 CONF_STATE_REASON = "state_reason"
 CONF_LAST_CHANGE_REASON = "last_change_reason"
+CONF_DISTANCE_GATE_MODE = "distance_gate_mode"
+CONF_DISTANCE_SOFT_MARGIN = "distance_soft_margin_cm"
+CONF_FRAMES_IN_WINDOW = "frames_in_window"
+CONF_FRAMES_ATTENUATED = "frames_attenuated"
+CONF_FRAMES_OUT_OF_WINDOW = "frames_out_of_window"
+CONF_IDLE_DECIMATION = "idle_decimation"
+CONF_CADENCE_WAKE_MARGIN = "cadence_wake_margin"
+CONF_FRAMES_PROCESSED = "frames_processed"
+CONF_FRAMES_DECIMATED = "frames_decimated"
+CONF_PROFILES = "profiles"
+CONF_MOVING_ENERGY_SENSOR = "moving_energy_sensor"
+CONF_SESSION_EXIT_GRACE = "session_exit_grace"
+CONF_SESSION_MIN_DURATION = "session_min_duration"
+CONF_RESTLESS_MOVING_ENERGY = "restless_moving_energy"
+CONF_SESSION_SUMMARY = "session_summary"
+CONF_SESSION_HISTORY = "session_history"
+CONF_TARGET_FALSE_ON_RATE = "target_false_on_rate"
+CONF_TARGET_FALSE_OFF_RATE = "target_false_off_rate"
+CONF_SUGGESTED_K_ON = "suggested_k_on"
+CONF_SUGGESTED_K_OFF = "suggested_k_off"
+CONF_SEPARATION_MARGIN = "separation_margin"
+CONF_CALIBRATION_MAX_RETRIES = "calibration_max_retries"
+CONF_CALIBRATION_MIN_LOOP_RATE = "calibration_min_loop_rate"
+CONF_CALIBRATION_QUALITY = "calibration_quality"
+CONF_OCCUPANCY_PROBABILITY = "occupancy_probability"
+CONF_OCCUPANCY_EVIDENCE_PERIOD = "occupancy_evidence_period"
+CONF_BLACK_BOX_INTERVAL = "black_box_interval"
+CONF_BLACK_BOX_STATUS = "black_box_status"
+CONF_FIXED_POINT = "fixed_point"
+CONF_FIXED_POINT_FRAC_BITS = "fixed_point_frac_bits"
 
-CONFIG_SCHEMA = binary_sensor.binary_sensor_schema(
+DistanceGateMode = bed_presence_engine_ns.enum("DistanceGateMode")
+DISTANCE_GATE_MODES = {
+    "hard": DistanceGateMode.GATE_HARD,
+    "zero_evidence": DistanceGateMode.GATE_ZERO_EVIDENCE,
+    "soft": DistanceGateMode.GATE_SOFT,
+}
+
+# Knobs that make up one engine parameter profile
+PROFILE_KEYS = [
+    CONF_K_ON,
+    CONF_K_OFF,
+    CONF_ON_DEBOUNCE_MS,
+    CONF_OFF_DEBOUNCE_MS,
+    CONF_ABS_CLEAR_DELAY_MS,
+    CONF_DISTANCE_MIN,
+    CONF_DISTANCE_MAX,
+]
+
+PROFILE_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_NAME): cv.string_strict,
+        cv.Optional(CONF_K_ON): cv.float_range(min=0.0, max=15.0),
+        cv.Optional(CONF_K_OFF): cv.float_range(min=0.0, max=15.0),
+        cv.Optional(CONF_ON_DEBOUNCE_MS): cv.positive_int,
+        cv.Optional(CONF_OFF_DEBOUNCE_MS): cv.positive_int,
+        cv.Optional(CONF_ABS_CLEAR_DELAY_MS): cv.positive_int,
+        cv.Optional(CONF_DISTANCE_MIN): cv.float_range(min=0.0, max=1000.0),
+        cv.Optional(CONF_DISTANCE_MAX): cv.float_range(min=0.0, max=1000.0),
+    }
+)
+
+
+def resolve_profile(config, profile):
+    """Named profiles inherit any knob they don't set from the base configuration."""
+    return {key: profile.get(key, config[key]) for key in PROFILE_KEYS}
+
+
+def validate_profile_values(name, values):
+    if values[CONF_K_ON] <= values[CONF_K_OFF]:
+        raise cv.Invalid(f"Profile '{name}': k_on must be greater than k_off")
+    if values[CONF_DISTANCE_MIN] >= values[CONF_DISTANCE_MAX]:
+        raise cv.Invalid(f"Profile '{name}': distance_min_cm must be below distance_max_cm")
+
+
+def validate_profiles(config):
+    validate_profile_values("default", resolve_profile(config, {}))
+    names = {"default", "custom"}
+    for profile in config[CONF_PROFILES]:
+        name = profile[CONF_NAME]
+        if name in names:
+            raise cv.Invalid(f"Profile name '{name}' is reserved or already used")
+        names.add(name)
+        validate_profile_values(name, resolve_profile(config, profile))
+    return config
+
+
+CONFIG_SCHEMA = cv.All(binary_sensor.binary_sensor_schema(
     BedPresenceEngine,
     device_class=DEVICE_CLASS_OCCUPANCY
 ).extend(
@@ -36,11 +122,50 @@ CONFIG_SCHEMA = binary_sensor.binary_sensor_schema(
         cv.Optional(CONF_DISTANCE_SENSOR): cv.use_id(sensor.Sensor),
         cv.Optional(CONF_DISTANCE_MIN, default=0.0): cv.float_range(min=0.0, max=1000.0),
         cv.Optional(CONF_DISTANCE_MAX, default=600.0): cv.float_range(min=0.0, max=1000.0),
+        cv.Optional(CONF_DISTANCE_GATE_MODE, default="hard"): cv.enum(DISTANCE_GATE_MODES, lower=True),
+        cv.Optional(CONF_DISTANCE_SOFT_MARGIN, default=50.0): cv.float_range(min=0.0, max=300.0),
+        cv.Optional(CONF_FRAMES_IN_WINDOW): sensor.sensor_schema(accuracy_decimals=0),
+        cv.Optional(CONF_FRAMES_ATTENUATED): sensor.sensor_schema(accuracy_decimals=0),
+        cv.Optional(CONF_FRAMES_OUT_OF_WINDOW): sensor.sensor_schema(accuracy_decimals=0),
+        cv.Optional(CONF_IDLE_DECIMATION, default=1): cv.int_range(min=1, max=64),
+        cv.Optional(CONF_CADENCE_WAKE_MARGIN, default=3.0): cv.float_range(min=0.0, max=15.0),
+        cv.Optional(CONF_FRAMES_PROCESSED): sensor.sensor_schema(accuracy_decimals=0),
+        cv.Optional(CONF_FRAMES_DECIMATED): sensor.sensor_schema(accuracy_decimals=0),
+        cv.Optional(CONF_PROFILES, default=[]): cv.All(cv.ensure_list(PROFILE_SCHEMA), cv.Length(max=3)),
+        cv.Optional(CONF_MOVING_ENERGY_SENSOR): cv.use_id(sensor.Sensor),
+        cv.Optional(CONF_SESSION_EXIT_GRACE, default="15min"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_SESSION_MIN_DURATION, default="10min"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_RESTLESS_MOVING_ENERGY, default=30.0): cv.float_range(min=0.0, max=100.0),
+        cv.Optional(CONF_SESSION_SUMMARY): text_sensor.text_sensor_schema(),
+        cv.Optional(CONF_SESSION_HISTORY): text_sensor.text_sensor_schema(),
+        cv.Optional(CONF_TARGET_FALSE_ON_RATE, default=0.001): cv.float_range(min=0.0, max=0.5),
+        cv.Optional(CONF_TARGET_FALSE_OFF_RATE, default=0.01): cv.float_range(min=0.0, max=0.5),
+        cv.Optional(CONF_SUGGESTED_K_ON): sensor.sensor_schema(accuracy_decimals=2),
+        cv.Optional(CONF_SUGGESTED_K_OFF): sensor.sensor_schema(accuracy_decimals=2),
+        cv.Optional(CONF_SEPARATION_MARGIN): sensor.sensor_schema(accuracy_decimals=2),
+        cv.Optional(CONF_CALIBRATION_MAX_RETRIES, default=1): cv.int_range(min=0, max=5),
+        cv.Optional(CONF_CALIBRATION_MIN_LOOP_RATE, default=0.2): cv.float_range(min=0.0, max=50.0),
+        cv.Optional(CONF_CALIBRATION_QUALITY): sensor.sensor_schema(accuracy_decimals=0),
+        cv.Optional(CONF_OCCUPANCY_PROBABILITY): sensor.sensor_schema(
+            accuracy_decimals=2, state_class=STATE_CLASS_MEASUREMENT
+        ),
+        cv.Optional(CONF_OCCUPANCY_EVIDENCE_PERIOD, default="3s"): cv.positive_time_period_milliseconds,
+        cv.Optional(CONF_BLACK_BOX_INTERVAL, default="1s"): cv.All(
+            cv.positive_time_period_milliseconds, cv.Range(max=cv.TimePeriod(seconds=60))
+        ),
+        cv.Optional(CONF_BLACK_BOX_STATUS): text_sensor.text_sensor_schema(),
+        cv.Optional(CONF_FIXED_POINT, default=False): cv.boolean,
+        cv.Optional(CONF_FIXED_POINT_FRAC_BITS, default=16): cv.int_range(min=8, max=20),
     }
-).extend(cv.COMPONENT_SCHEMA)
+).extend(cv.COMPONENT_SCHEMA), validate_profiles)
 
 
 async def to_code(config):
+    # Compile-time decision arithmetic (fixed_point.h); the component is built once per firmware
+    if config[CONF_FIXED_POINT]:
+        cg.add_build_flag("-DBED_PRESENCE_FIXED_POINT")
+        cg.add_build_flag(f"-DBED_PRESENCE_Q_FRAC_BITS={config[CONF_FIXED_POINT_FRAC_BITS]}")
+
     var = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(var, config)
     await binary_sensor.register_binary_sensor(var, config)
@@ -54,6 +179,21 @@ async def to_code(config):
 
     cg.add(var.set_d_min_cm(config[CONF_DISTANCE_MIN]))
     cg.add(var.set_d_max_cm(config[CONF_DISTANCE_MAX]))
+    cg.add(var.set_distance_gate_mode(config[CONF_DISTANCE_GATE_MODE]))
+    cg.add(var.set_distance_soft_margin_cm(config[CONF_DISTANCE_SOFT_MARGIN]))
+
+    # Gate decision counters
+    if CONF_FRAMES_IN_WINDOW in config:
+        sens = await sensor.new_sensor(config[CONF_FRAMES_IN_WINDOW])
+        cg.add(var.set_frames_in_window_sensor(sens))
+
+    if CONF_FRAMES_ATTENUATED in config:
+        sens = await sensor.new_sensor(config[CONF_FRAMES_ATTENUATED])
+        cg.add(var.set_frames_attenuated_sensor(sens))
+
+    if CONF_FRAMES_OUT_OF_WINDOW in config:
+        sens = await sensor.new_sensor(config[CONF_FRAMES_OUT_OF_WINDOW])
+        cg.add(var.set_frames_out_of_window_sensor(sens))
 
     cg.add(var.set_k_on(config[CONF_K_ON]))
     cg.add(var.set_k_off(config[CONF_K_OFF]))
@@ -63,6 +203,86 @@ async def to_code(config):
     cg.add(var.set_off_debounce_ms(config[CONF_OFF_DEBOUNCE_MS]))
     cg.add(var.set_abs_clear_delay_ms(config[CONF_ABS_CLEAR_DELAY_MS]))
 
+    # Named presets, fully resolved against the base configuration
+    for profile in config[CONF_PROFILES]:
+        values = resolve_profile(config, profile)
+        cg.add(
+            var.add_profile(
+                profile[CONF_NAME],
+                values[CONF_K_ON],
+                values[CONF_K_OFF],
+                values[CONF_ON_DEBOUNCE_MS],
+                values[CONF_OFF_DEBOUNCE_MS],
+                values[CONF_ABS_CLEAR_DELAY_MS],
+                values[CONF_DISTANCE_MIN],
+                values[CONF_DISTANCE_MAX],
+            )
+        )
+
+    # Adaptive processing cadence
+    cg.add(var.set_idle_decimation(config[CONF_IDLE_DECIMATION]))
+    cg.add(var.set_cadence_wake_margin(config[CONF_CADENCE_WAKE_MARGIN]))
+
+    if CONF_FRAMES_PROCESSED in config:
+        sens = await sensor.new_sensor(config[CONF_FRAMES_PROCESSED])
+        cg.add(var.set_frames_processed_sensor(sens))
+
+    if CONF_FRAMES_DECIMATED in config:
+        sens = await sensor.new_sensor(config[CONF_FRAMES_DECIMATED])
+        cg.add(var.set_frames_decimated_sensor(sens))
+
+    # Sleep-session aggregation
+    if CONF_MOVING_ENERGY_SENSOR in config:
+        moving_sensor = await cg.get_variable(config[CONF_MOVING_ENERGY_SENSOR])
+        cg.add(var.set_moving_energy_sensor(moving_sensor))
+
+    cg.add(var.set_session_exit_grace_ms(config[CONF_SESSION_EXIT_GRACE]))
+    cg.add(var.set_session_min_duration_ms(config[CONF_SESSION_MIN_DURATION]))
+    cg.add(var.set_restless_moving_energy(config[CONF_RESTLESS_MOVING_ENERGY]))
+
+    if CONF_SESSION_SUMMARY in config:
+        summary_sensor = await text_sensor.new_text_sensor(config[CONF_SESSION_SUMMARY])
+        cg.add(var.set_session_summary_sensor(summary_sensor))
+
+    if CONF_SESSION_HISTORY in config:
+        history_sensor = await text_sensor.new_text_sensor(config[CONF_SESSION_HISTORY])
+        cg.add(var.set_session_history_sensor(history_sensor))
+
+    # Two-class calibration targets + outputs
+    cg.add(var.set_target_false_on_rate(config[CONF_TARGET_FALSE_ON_RATE]))
+    cg.add(var.set_target_false_off_rate(config[CONF_TARGET_FALSE_OFF_RATE]))
+
+    if CONF_SUGGESTED_K_ON in config:
+        sens = await sensor.new_sensor(config[CONF_SUGGESTED_K_ON])
+        cg.add(var.set_suggested_k_on_sensor(sens))
+
+    if CONF_SUGGESTED_K_OFF in config:
+        sens = await sensor.new_sensor(config[CONF_SUGGESTED_K_OFF])
+        cg.add(var.set_suggested_k_off_sensor(sens))
+
+    if CONF_SEPARATION_MARGIN in config:
+        sens = await sensor.new_sensor(config[CONF_SEPARATION_MARGIN])
+        cg.add(var.set_separation_margin_sensor(sens))
+
+    # Calibration session quality gating
+    cg.add(var.set_calibration_max_retries(config[CONF_CALIBRATION_MAX_RETRIES]))
+    cg.add(var.set_calibration_min_loop_rate(config[CONF_CALIBRATION_MIN_LOOP_RATE]))
+    if CONF_CALIBRATION_QUALITY in config:
+        sens = await sensor.new_sensor(config[CONF_CALIBRATION_QUALITY])
+        cg.add(var.set_calibration_quality_sensor(sens))
+
+    # HMM occupancy probability (filter only runs when the sensor is configured)
+    cg.add(var.set_occupancy_evidence_period_ms(config[CONF_OCCUPANCY_EVIDENCE_PERIOD]))
+    if CONF_OCCUPANCY_PROBABILITY in config:
+        sens = await sensor.new_sensor(config[CONF_OCCUPANCY_PROBABILITY])
+        cg.add(var.set_occupancy_probability_sensor(sens))
+
+    # Black box (always recording; the status sensor announces each freeze)
+    cg.add(var.set_black_box_interval_ms(config[CONF_BLACK_BOX_INTERVAL]))
+    if CONF_BLACK_BOX_STATUS in config:
+        status_sensor = await text_sensor.new_text_sensor(config[CONF_BLACK_BOX_STATUS])
+        cg.add(var.set_black_box_status_sensor(status_sensor))
+
     if CONF_STATE_REASON in config:
         reason_sensor = await text_sensor.new_text_sensor(config[CONF_STATE_REASON])
         cg.add(var.set_state_reason_sensor(reason_sensor))
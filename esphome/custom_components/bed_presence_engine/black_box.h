@@ -0,0 +1,229 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace bed_presence_engine {
+
+// How the distance gate treated a frame
+enum BlackBoxGate : uint8_t {
+  BLACK_BOX_IN_WINDOW,
+  BLACK_BOX_ATTENUATED,     // Soft/zero-evidence gate scaled the evidence
+  BLACK_BOX_OUT_OF_WINDOW,  // Hard gate dropped the frame
+};
+
+// Each reason has its own snapshot slot
+enum BlackBoxFreezeReason : uint8_t {
+  BLACK_BOX_NOT_FROZEN,
+  BLACK_BOX_FROZEN_ON,      // OFF→ON transition
+  BLACK_BOX_FROZEN_OFF,     // ON→OFF transition
+  BLACK_BOX_FROZEN_MANUAL,  // On demand
+};
+
+// One engine decision, 12 bytes
+struct BlackBoxRecord {
+  static constexpr uint8_t BOOT_MARKER = 0xFF;  // `state` of the record written at each boot
+
+  uint32_t t_ms;
+  int16_t z_centi;       // z × 100, saturated
+  uint16_t debounce_ds;  // Time since the current debounce started (0.1 s, saturated)
+  uint16_t high_ds;      // Time since the last z > k_on (0.1 s, saturated)
+  uint8_t state;         // Engine State, or BOOT_MARKER
+  uint8_t gate;          // BlackBoxGate
+};
+
+/**
+ * Raw black-box memory. Plain data with no constructor so it can live in
+ * RTC no-init memory and survive a soft reboot (panic, watchdog, OTA,
+ * restart button); `magic` encodes the layout so a power-on or a firmware
+ * with a different layout starts fresh.
+ */
+struct BlackBoxStorage {
+  static constexpr size_t CAPACITY = 120;     // Two minutes at the default 1 s record interval
+  static constexpr size_t NUM_SNAPSHOTS = 3;  // Last ON, last OFF, last manual freeze
+  static constexpr uint32_t MAGIC =
+      0xB1AC0000u ^ (CAPACITY << 8) ^ (NUM_SNAPSHOTS << 4) ^ sizeof(BlackBoxRecord);
+
+  struct Snapshot {
+    uint32_t count;
+    uint32_t at_ms;
+    uint32_t boot;
+    BlackBoxRecord records[CAPACITY];  // Oldest first
+  };
+
+  uint32_t magic;
+  uint32_t boot_count;
+  uint32_t head;  // Records ever written to `live`; published after the record is complete
+  uint8_t latest_frozen;  // BlackBoxFreezeReason of the newest snapshot
+  BlackBoxRecord live[CAPACITY];
+  Snapshot frozen[NUM_SNAPSHOTS];  // Indexed by BlackBoxFreezeReason - 1
+};
+
+/**
+ * Always-on flight recorder for engine decisions.
+ *
+ * - Single writer (the component loop), no locks: a record is written in
+ *   full before `head` is advanced behind a release fence, so a crash never
+ *   exposes a torn record.
+ * - Fixed cost per frame: one compare, plus a 12-byte copy at most once per
+ *   record interval or when the engine state changes.
+ * - freeze() copies the live ring into the snapshot slot of its reason, so
+ *   the last OFF transition survives a later ON (and vice versa) and a manual
+ *   freeze never displaces either; the engine freezes on every ON↔OFF
+ *   transition.
+ */
+class BlackBox {
+ public:
+  // Returns true when the storage held a valid recording from before this boot
+  bool attach(BlackBoxStorage *storage) {
+    this->storage_ = storage;
+    bool recovered = storage->magic == BlackBoxStorage::MAGIC &&
+                     storage->latest_frozen <= BlackBoxStorage::NUM_SNAPSHOTS;
+    for (size_t i = 0; recovered && i < BlackBoxStorage::NUM_SNAPSHOTS; ++i) {
+      recovered = storage->frozen[i].count <= BlackBoxStorage::CAPACITY;
+    }
+    if (!recovered) {
+      storage->boot_count = 0;
+      storage->head = 0;
+      storage->latest_frozen = BLACK_BOX_NOT_FROZEN;
+      for (auto &snapshot : storage->frozen) {
+        snapshot.count = 0;
+        snapshot.at_ms = 0;
+        snapshot.boot = 0;
+      }
+      std::atomic_thread_fence(std::memory_order_release);
+      storage->magic = BlackBoxStorage::MAGIC;
+    } else {
+      storage->boot_count++;
+    }
+
+    BlackBoxRecord marker{};
+    marker.state = BlackBoxRecord::BOOT_MARKER;
+    this->append(marker);
+    bool any_frozen = false;
+    for (const auto &snapshot : storage->frozen) {
+      any_frozen = any_frozen || snapshot.count > 0;
+    }
+    return recovered && (storage->head > 1 || any_frozen);
+  }
+
+  bool attached() const { return this->storage_ != nullptr; }
+  void set_interval_ms(uint32_t ms) { this->interval_ms_ = ms; }
+  // Bit per state value (< 32) that can flip every frame, e.g. a debounce started and aborted
+  void set_transient_states(uint32_t mask) { this->transient_states_ = mask; }
+
+  /**
+   * Offer one processed frame. Recorded when the interval elapsed or the
+   * engine entered a settled state other than the last settled one recorded;
+   * entries into transient states wait for the interval, so a z hovering at a
+   * threshold cannot flood the ring. Returns true if written.
+   * `z_centi` is z × 100, already saturated (DecisionMath::to_centi).
+   */
+  bool record(uint32_t now, int16_t z_centi, uint8_t state, uint8_t gate, uint32_t debounce_ms, uint32_t high_ms) {
+    if (this->storage_ == nullptr) {
+      return false;
+    }
+    bool transient = state < 32 && ((this->transient_states_ >> state) & 1u) != 0;
+    bool decision = !transient && (!this->has_settled_ || state != this->last_settled_);
+    if (this->has_last_ && !decision && now - this->last_record_ms_ < this->interval_ms_) {
+      return false;
+    }
+    this->has_last_ = true;
+    this->last_record_ms_ = now;
+    if (!transient) {
+      this->has_settled_ = true;
+      this->last_settled_ = state;
+    }
+
+    BlackBoxRecord rec;
+    rec.t_ms = now;
+    rec.z_centi = z_centi;
+    rec.debounce_ds = saturate_ds(debounce_ms);
+    rec.high_ds = saturate_ds(high_ms);
+    rec.state = state;
+    rec.gate = gate;
+    this->append(rec);
+    return true;
+  }
+
+  // Snapshot the live ring (oldest first) into the slot of `reason`; returns the number of records captured
+  size_t freeze(uint32_t now, BlackBoxFreezeReason reason) {
+    if (this->storage_ == nullptr || reason == BLACK_BOX_NOT_FROZEN) {
+      return 0;
+    }
+    BlackBoxStorage *s = this->storage_;
+    BlackBoxStorage::Snapshot &snapshot = s->frozen[reason - 1];
+    snapshot.count = 0;  // Invalidate first: a crash mid-copy leaves an empty snapshot, not a torn one
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t count = this->live_size();
+    uint32_t first = s->head - static_cast<uint32_t>(count);
+    for (size_t i = 0; i < count; ++i) {
+      snapshot.records[i] = s->live[(first + i) % BlackBoxStorage::CAPACITY];
+    }
+    snapshot.at_ms = now;
+    snapshot.boot = s->boot_count;
+    std::atomic_thread_fence(std::memory_order_release);
+    snapshot.count = static_cast<uint32_t>(count);
+    s->latest_frozen = reason;
+    return count;
+  }
+
+  size_t live_size() const {
+    if (this->storage_ == nullptr) {
+      return 0;
+    }
+    return this->storage_->head < BlackBoxStorage::CAPACITY ? this->storage_->head : BlackBoxStorage::CAPACITY;
+  }
+
+  // index 0 is the oldest retained record
+  const BlackBoxRecord &live(size_t index) const {
+    uint32_t first = this->storage_->head - static_cast<uint32_t>(this->live_size());
+    return this->storage_->live[(first + index) % BlackBoxStorage::CAPACITY];
+  }
+
+  // Reason of the most recent non-empty snapshot, BLACK_BOX_NOT_FROZEN if there is none
+  BlackBoxFreezeReason latest_frozen() const {
+    if (this->storage_ == nullptr || this->storage_->latest_frozen == BLACK_BOX_NOT_FROZEN) {
+      return BLACK_BOX_NOT_FROZEN;
+    }
+    auto reason = static_cast<BlackBoxFreezeReason>(this->storage_->latest_frozen);
+    return this->frozen_size(reason) > 0 ? reason : BLACK_BOX_NOT_FROZEN;
+  }
+
+  size_t frozen_size(BlackBoxFreezeReason reason) const {
+    if (this->storage_ == nullptr || reason == BLACK_BOX_NOT_FROZEN) {
+      return 0;
+    }
+    return this->storage_->frozen[reason - 1].count;
+  }
+  const BlackBoxRecord &frozen(BlackBoxFreezeReason reason, size_t index) const {
+    return this->storage_->frozen[reason - 1].records[index];
+  }
+  uint32_t frozen_at_ms(BlackBoxFreezeReason reason) const { return this->storage_->frozen[reason - 1].at_ms; }
+  uint32_t frozen_boot(BlackBoxFreezeReason reason) const { return this->storage_->frozen[reason - 1].boot; }
+  uint32_t boot_count() const { return this->storage_->boot_count; }
+
+ protected:
+  static uint16_t saturate_ds(uint32_t ms) { return ms / 100 >= 0xFFFF ? 0xFFFF : static_cast<uint16_t>(ms / 100); }
+
+  void append(const BlackBoxRecord &rec) {
+    BlackBoxStorage *s = this->storage_;
+    s->live[s->head % BlackBoxStorage::CAPACITY] = rec;
+    std::atomic_thread_fence(std::memory_order_release);
+    s->head = s->head + 1;
+  }
+
+  BlackBoxStorage *storage_{nullptr};
+  uint32_t interval_ms_{1000};
+  uint32_t last_record_ms_{0};
+  uint32_t transient_states_{0};
+  uint8_t last_settled_{0};
+  bool has_last_{false};
+  bool has_settled_{false};
+};
+
+}  // namespace bed_presence_engine
+}  // namespace esphome
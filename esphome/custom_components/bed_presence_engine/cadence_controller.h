@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+#include "fixed_point.h"
+
+namespace esphome {
+namespace bed_presence_engine {
+
+/**
+ * Adaptive processing cadence for a quiet, idle engine.
+ *
+ * While the engine is IDLE and every raw frame stays below the wake energy
+ * (k_on minus a safety margin, in energy units), frames are folded into
+ * block means of `decimation` frames and only the mean is processed. The
+ * boxcar average doubles as the anti-aliasing filter; the per-frame cost is
+ * one compare and one add.
+ *
+ * Any frame at or above the wake energy, any non-IDLE state, or an active
+ * calibration drops the partial block and processes that same frame, so the
+ * IDLE → DEBOUNCING_ON decision (and therefore detection latency) is
+ * unchanged: decimated frames are all below k_on, and so is their mean.
+ * After waking, `decimation` quiet frames run at full rate before blocks
+ * resume. Energies and block sums use the `Math` policy of fixed_point.h.
+ */
+template <typename Math> class BasicCadenceController {
+ public:
+  void set_decimation(uint32_t factor) { decimation_ = factor < 1 ? 1 : factor; }
+  uint32_t decimation() const { return decimation_; }
+
+  // true when a frame should be processed now; `energy` becomes the block mean after a decimated block
+  bool admit(typename Math::value_t &energy, bool may_decimate, typename Math::value_t wake_energy) {
+    if (this->decimation_ <= 1 || !may_decimate || energy >= wake_energy) {
+      this->block_sum_ = 0;
+      this->block_count_ = 0;
+      this->quiet_frames_ = 0;
+      this->frames_processed_++;
+      return true;
+    }
+
+    if (this->quiet_frames_ < this->decimation_) {
+      this->quiet_frames_++;
+      this->frames_processed_++;
+      return true;
+    }
+
+    this->block_sum_ += energy;
+    if (++this->block_count_ < this->decimation_) {
+      this->frames_skipped_++;
+      return false;
+    }
+
+    energy = Math::average(this->block_sum_, this->block_count_);
+    this->block_sum_ = 0;
+    this->block_count_ = 0;
+    this->frames_processed_++;
+    return true;
+  }
+
+  bool decimating() const { return this->decimation_ > 1 && this->quiet_frames_ >= this->decimation_; }
+  uint32_t frames_processed() const { return this->frames_processed_; }
+  uint32_t frames_skipped() const { return this->frames_skipped_; }
+
+ protected:
+  uint32_t decimation_{1};
+  uint32_t quiet_frames_{0};
+  typename Math::sum_t block_sum_{0};
+  uint32_t block_count_{0};
+  uint32_t frames_processed_{0};
+  uint32_t frames_skipped_{0};
+};
+
+using CadenceController = BasicCadenceController<FloatMath>;
+
+}  // namespace bed_presence_engine
+}  // namespace esphome
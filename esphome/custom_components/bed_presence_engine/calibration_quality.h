@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "energy_histogram.h"
+
+namespace esphome {
+namespace bed_presence_engine {
+
+// Acceptance limits for a calibration session
+struct CalibrationQualityLimits {
+  float max_drift_sigma{1.0f};        // Spread of sub-window means, in σ
+  float max_outlier_fraction{0.05f};  // Share of samples beyond outlier_k σ of the median
+  float min_loop_rate_hz{0.2f};       // Engine frames per second (a stalled main loop, not a silent radar)
+  float max_rejection_rate{0.5f};     // Share of frames dropped by the distance window
+  float outlier_k{4.0f};
+};
+
+struct CalibrationQualityReport {
+  float drift_sigma{0.0f};
+  float outlier_fraction{0.0f};
+  float loop_rate_hz{0.0f};
+  float rejection_rate{0.0f};
+  float score{0.0f};               // 0-100; each metric costs up to 25 points as it approaches its limit
+  const char *failure{nullptr};    // nullptr when every metric is within its limit
+
+  // Transient problems (someone walked through, loop stall) are worth another attempt;
+  // a window that rejects most frames will not fix itself
+  bool retryable() const { return this->failure != nullptr && std::strcmp(this->failure, "distance_rejected") != 0; }
+};
+
+/**
+ * Streaming quality metrics for one calibration session.
+ *
+ * Constant memory regardless of duration: the session is split into
+ * NUM_SUBWINDOWS equal time slices with a running mean each (stationarity),
+ * accepted/rejected frame counters (loop rate, distance rejection rate), and
+ * the session histogram supplies the outlier fraction at evaluation time.
+ */
+class CalibrationQuality {
+ public:
+  static constexpr int NUM_SUBWINDOWS = 4;
+
+  void start(uint32_t now, uint32_t duration_ms) {
+    this->start_ms_ = now;
+    this->duration_ms_ = duration_ms == 0 ? 1 : duration_ms;
+    for (int i = 0; i < NUM_SUBWINDOWS; ++i) {
+      this->window_count_[i] = 0;
+      this->window_mean_[i] = 0.0f;
+    }
+    this->accepted_ = 0;
+    this->rejected_ = 0;
+  }
+
+  // Frame inside the distance window (fed to calibration)
+  void add_sample(uint32_t now, float energy) {
+    uint32_t elapsed = now - this->start_ms_;
+    int window = static_cast<int>(static_cast<uint64_t>(elapsed) * NUM_SUBWINDOWS / this->duration_ms_);
+    if (window >= NUM_SUBWINDOWS) {
+      window = NUM_SUBWINDOWS - 1;
+    }
+    uint32_t n = ++this->window_count_[window];
+    this->window_mean_[window] += (energy - this->window_mean_[window]) / static_cast<float>(n);
+    this->accepted_++;
+  }
+
+  // Frame dropped or attenuated by the distance window
+  void add_rejected() { this->rejected_++; }
+
+  /**
+   * Score the session. `center`/`sigma` are the robust location and scale of the
+   * session (σ is floored at one energy percent so integer quantization of a
+   * very quiet room does not turn every ±1 step into drift or an outlier).
+   */
+  CalibrationQualityReport evaluate(uint32_t now, const EnergyHistogram &histogram, float center, float sigma,
+                                    const CalibrationQualityLimits &limits) const {
+    CalibrationQualityReport report;
+    float scale = std::fmax(sigma, 1.0f);
+
+    // Stationarity: spread of sub-window means (windows with too few samples are skipped)
+    float lo = 0.0f;
+    float hi = 0.0f;
+    bool any = false;
+    for (int i = 0; i < NUM_SUBWINDOWS; ++i) {
+      if (this->window_count_[i] < MIN_WINDOW_SAMPLES) {
+        continue;
+      }
+      float m = this->window_mean_[i];
+      lo = any ? std::fmin(lo, m) : m;
+      hi = any ? std::fmax(hi, m) : m;
+      any = true;
+    }
+    report.drift_sigma = any ? (hi - lo) / scale : 0.0f;
+
+    // Outliers relative to the robust spread
+    if (!histogram.empty()) {
+      float limit = limits.outlier_k * scale;
+      uint32_t outliers = 0;
+      for (int e = 0; e < EnergyHistogram::NUM_BINS; ++e) {
+        if (std::fabs(static_cast<float>(e) - center) > limit) {
+          outliers += histogram.bins[e];
+        }
+      }
+      report.outlier_fraction = static_cast<float>(outliers) / static_cast<float>(histogram.total);
+    }
+
+    // Sensors publish on change only (a quiet bed repeats one value), so this counts engine frames: the rate of
+    // the main loop re-reading the last value. It catches a stalled loop; a radar that stops is not visible here
+    uint32_t frames = this->accepted_ + this->rejected_;
+    float elapsed_s = static_cast<float>(now - this->start_ms_) / 1000.0f;
+    report.loop_rate_hz = elapsed_s > 0.0f ? static_cast<float>(frames) / elapsed_s : 0.0f;
+
+    report.rejection_rate = frames > 0 ? static_cast<float>(this->rejected_) / static_cast<float>(frames) : 1.0f;
+
+    // Worst offender first: distance problems are not retryable, so they take precedence
+    float r_drift = report.drift_sigma / limits.max_drift_sigma;
+    float r_outliers = report.outlier_fraction / limits.max_outlier_fraction;
+    float r_rate = report.loop_rate_hz > 0.0f ? limits.min_loop_rate_hz / report.loop_rate_hz : 2.0f;
+    float r_rejected = report.rejection_rate / limits.max_rejection_rate;
+    if (r_rejected >= 1.0f) {
+      report.failure = "distance_rejected";
+    } else if (r_rate >= 1.0f) {
+      report.failure = "stalled_loop";
+    } else if (r_drift >= 1.0f) {
+      report.failure = "non_stationary";
+    } else if (r_outliers >= 1.0f) {
+      report.failure = "outliers";
+    }
+
+    report.score = 100.0f - 25.0f * (std::fmin(r_drift, 1.0f) + std::fmin(r_outliers, 1.0f) +
+                                     std::fmin(r_rate, 1.0f) + std::fmin(r_rejected, 1.0f));
+    return report;
+  }
+
+ protected:
+  static constexpr uint32_t MIN_WINDOW_SAMPLES = 5;
+
+  uint32_t start_ms_{0};
+  uint32_t duration_ms_{1};
+  uint32_t window_count_[NUM_SUBWINDOWS]{};
+  float window_mean_[NUM_SUBWINDOWS]{};
+  uint32_t accepted_{0};
+  uint32_t rejected_{0};
+};
+
+}  // namespace bed_presence_engine
+}  // namespace esphome
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace bed_presence_engine {
+
+/**
+ * Constant-memory energy distribution for streaming calibration.
+ *
+ * LD2410 gate energies are integer percentages (0-100), so one bin per percent
+ * records a calibration session of any length exactly. Out-of-range readings
+ * are clamped into the edge bins.
+ */
+struct EnergyHistogram {
+  static constexpr int NUM_BINS = 101;
+
+  uint32_t bins[NUM_BINS]{};
+  uint32_t total{0};
+
+  void clear() {
+    for (int i = 0; i < NUM_BINS; ++i) {
+      this->bins[i] = 0;
+    }
+    this->total = 0;
+  }
+
+  void add(float energy) {
+    int bin = static_cast<int>(std::lround(energy));
+    if (bin < 0) {
+      bin = 0;
+    } else if (bin >= NUM_BINS) {
+      bin = NUM_BINS - 1;
+    }
+    this->bins[bin]++;
+    this->total++;
+  }
+
+  bool empty() const { return this->total == 0; }
+
+  float mean() const {
+    if (this->total == 0) {
+      return 0.0f;
+    }
+    uint64_t sum = 0;
+    for (int e = 0; e < NUM_BINS; ++e) {
+      sum += static_cast<uint64_t>(e) * this->bins[e];
+    }
+    return static_cast<float>(sum) / static_cast<float>(this->total);
+  }
+
+  // Twice the median, averaging the two middle readings of an even count (matches a sorted-sample median)
+  int median_x2() const {
+    return this->order_statistic((this->total - 1) / 2) + this->order_statistic(this->total / 2);
+  }
+
+  // Four times the MAD around median_x2()/2, with the same even-count averaging
+  int mad_x4(int median_x2) const {
+    // Every |2e - median_x2| has the parity of median_x2, so d = 2k + parity and k indexes NUM_BINS buckets
+    uint32_t deviations[NUM_BINS]{};
+    for (int e = 0; e < NUM_BINS; ++e) {
+      int d = 2 * e - median_x2;
+      deviations[(d < 0 ? -d : d) >> 1] += this->bins[e];
+    }
+    int parity = median_x2 & 1;
+    return 2 * (select_bin(deviations, NUM_BINS, (this->total - 1) / 2) +
+                select_bin(deviations, NUM_BINS, this->total / 2) + parity);
+  }
+
+  float stddev() const {
+    if (this->total < 2) {
+      return 0.0f;
+    }
+    float m = this->mean();
+    float ss = 0.0f;
+    for (int e = 0; e < NUM_BINS; ++e) {
+      float d = static_cast<float>(e) - m;
+      ss += d * d * static_cast<float>(this->bins[e]);
+    }
+    return std::sqrt(ss / static_cast<float>(this->total - 1));
+  }
+
+  // k-th smallest reading (0-based); 0 when empty
+  int order_statistic(uint32_t k) const { return select_bin(this->bins, NUM_BINS, k); }
+
+  // Smallest energy e such that at most `rate` of the samples lie strictly above e
+  int upper_tail(float rate) const {
+    uint32_t allowed = static_cast<uint32_t>(rate * static_cast<float>(this->total));
+    uint32_t above = 0;
+    for (int e = NUM_BINS - 1; e > 0; --e) {
+      if (above + this->bins[e] > allowed) {
+        return e;
+      }
+      above += this->bins[e];
+    }
+    return 0;
+  }
+
+  // Largest energy e such that at most `rate` of the samples lie strictly below e
+  int lower_tail(float rate) const {
+    uint32_t allowed = static_cast<uint32_t>(rate * static_cast<float>(this->total));
+    uint32_t below = 0;
+    for (int e = 0; e < NUM_BINS - 1; ++e) {
+      if (below + this->bins[e] > allowed) {
+        return e;
+      }
+      below += this->bins[e];
+    }
+    return NUM_BINS - 1;
+  }
+
+ protected:
+  // Index of the bin holding the k-th smallest count-weighted entry
+  static int select_bin(const uint32_t *bins, int num_bins, uint32_t k) {
+    uint32_t seen = 0;
+    for (int e = 0; e < num_bins; ++e) {
+      seen += bins[e];
+      if (seen > k) {
+        return e;
+      }
+    }
+    return 0;
+  }
+};
+
+struct ThresholdSuggestion {
+  bool valid{false};
+  float k_on{0.0f};
+  float k_off{0.0f};
+  float margin{0.0f};     // z-units between the empty upper tail and the occupied lower tail (<= 0: overlap)
+  int empty_upper{0};     // Empty-bed energy exceeded by at most false_on_rate of frames
+  int occupied_lower{0};  // Occupied-bed energy undershot by at most false_off_rate of frames
+  bool clamped{false};    // Thresholds split only the part of the gap inside k ∈ [0, k_max]
+};
+
+/**
+ * Derive k_on/k_off from the empty-bed and occupied-bed energy distributions.
+ *
+ * Any threshold in (empty_upper, occupied_lower] keeps per-frame false-on and
+ * false-off rates within their targets. The gap is split in thirds so k_off
+ * sits above the empty-bed tail, k_on below the occupied-bed tail, and the two
+ * keep a hysteresis band between them. Thresholds are expressed as z-scores
+ * against the supplied baseline. When part of the gap lies outside k ∈ [0, k_max]
+ * (the range the engine accepts), only the reachable part is split.
+ */
+inline ThresholdSuggestion derive_thresholds(const EnergyHistogram &empty, const EnergyHistogram &occupied, float mu,
+                                             float sigma, float false_on_rate, float false_off_rate, float k_max) {
+  ThresholdSuggestion result;
+  if (empty.empty() || occupied.empty() || sigma <= 0.001f) {
+    return result;
+  }
+
+  result.empty_upper = empty.upper_tail(false_on_rate);
+  result.occupied_lower = occupied.lower_tail(false_off_rate);
+
+  float gap = static_cast<float>(result.occupied_lower - result.empty_upper);
+  result.margin = gap / sigma;
+
+  float lo = std::fmax(static_cast<float>(result.empty_upper), mu);
+  float hi = std::fmin(static_cast<float>(result.occupied_lower), mu + k_max * sigma);
+  result.clamped = lo != static_cast<float>(result.empty_upper) || hi != static_cast<float>(result.occupied_lower);
+  float span = hi - lo;
+
+  float off_energy = lo + span / 3.0f;
+  float on_energy = lo + 2.0f * span / 3.0f;
+  result.k_off = (off_energy - mu) / sigma;
+  result.k_on = (on_energy - mu) / sigma;
+  result.valid = gap > 0.0f && span > 0.0f;
+  return result;
+}
+
+}  // namespace bed_presence_engine
+}  // namespace esphome
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+namespace bed_presence_engine {
+
+/**
+ * Complete set of tunable engine parameters.
+ *
+ * The state machine only ever reads parameters through a pointer to one of
+ * these, so a profile is applied all at once between frames and never as a
+ * half-updated mix of old and new knobs.
+ */
+struct EngineProfile {
+  static constexpr float K_MAX = 15.0f;  // Largest k_on/k_off the schema and the threshold sliders accept
+
+  const char *name{"default"};
+  float k_on{9.0f};
+  float k_off{4.0f};
+  unsigned long on_debounce_ms{3000};
+  unsigned long off_debounce_ms{5000};
+  unsigned long abs_clear_delay_ms{30000};
+  float d_min_cm{0.0f};
+  float d_max_cm{600.0f};
+
+  // nullptr when the profile is consistent, otherwise a short reason code
+  const char *validate() const {
+    if (!std::isfinite(this->k_on) || !std::isfinite(this->k_off) || !std::isfinite(this->d_min_cm) ||
+        !std::isfinite(this->d_max_cm)) {
+      return "non_finite";
+    }
+    if (this->k_off < 0.0f || this->k_on <= this->k_off) {
+      return "k_on_not_above_k_off";
+    }
+    if (this->d_min_cm < 0.0f || this->d_min_cm >= this->d_max_cm) {
+      return "d_min_not_below_d_max";
+    }
+    return nullptr;
+  }
+
+  bool same_parameters(const EngineProfile &other) const {
+    return this->k_on == other.k_on && this->k_off == other.k_off && this->on_debounce_ms == other.on_debounce_ms &&
+           this->off_debounce_ms == other.off_debounce_ms && this->abs_clear_delay_ms == other.abs_clear_delay_ms &&
+           this->d_min_cm == other.d_min_cm && this->d_max_cm == other.d_max_cm;
+  }
+};
+
+/**
+ * Immutable named presets plus a double-buffered "custom" profile.
+ *
+ * - Presets are validated when added and switched by pointer.
+ * - Individual knob updates go to a staging copy; commit_pending() publishes
+ *   it into the inactive custom buffer and swaps the active pointer, but only
+ *   once the staged combination validates. Inconsistent intermediate states
+ *   (e.g. k_on lowered below k_off before k_off is lowered) stay staged.
+ * - generation() changes whenever the active profile does. The two custom
+ *   buffers alternate, so the active address can repeat across installs and is
+ *   not a valid cache key for values derived from the profile.
+ */
+class ProfileStore {
+ public:
+  static constexpr size_t MAX_PRESETS = 4;  // "default" + three named presets
+
+  enum CommitResult { COMMIT_NONE, COMMIT_APPLIED, COMMIT_UNCHANGED, COMMIT_REJECTED };
+
+  ProfileStore() = default;
+  ProfileStore(const ProfileStore &) = delete;
+  ProfileStore &operator=(const ProfileStore &) = delete;
+
+  // Configuration-time access to the "default" preset (before setup)
+  EngineProfile &base() { return this->presets_[0]; }
+
+  const EngineProfile &active() const { return *this->active_; }
+  const EngineProfile *active_ptr() const { return this->active_; }
+  size_t preset_count() const { return this->preset_count_; }
+  const EngineProfile &preset(size_t index) const { return this->presets_[index]; }
+  bool has_pending() const { return this->pending_dirty_; }
+  uint32_t generation() const { return this->generation_; }
+
+  // nullptr on success, otherwise a reason code
+  const char *add_preset(const EngineProfile &profile) {
+    if (this->preset_count_ >= MAX_PRESETS) {
+      return "too_many_presets";
+    }
+    if (this->find(profile.name) != nullptr) {
+      return "duplicate_name";
+    }
+    const char *reason = profile.validate();
+    if (reason != nullptr) {
+      return reason;
+    }
+    this->presets_[this->preset_count_++] = profile;
+    return nullptr;
+  }
+
+  const EngineProfile *find(const char *name) const {
+    for (size_t i = 0; i < this->preset_count_; ++i) {
+      if (std::strcmp(this->presets_[i].name, name) == 0) {
+        return &this->presets_[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // Switch to a named preset; discards staged edits
+  bool select(const char *name) {
+    const EngineProfile *profile = this->find(name);
+    if (profile == nullptr || profile->validate() != nullptr) {
+      return false;
+    }
+    this->active_ = profile;
+    this->pending_dirty_ = false;
+    this->generation_++;
+    return true;
+  }
+
+  // Staging copy for piecemeal updates, seeded from the active profile
+  EngineProfile &edit() {
+    if (!this->pending_dirty_) {
+      this->pending_ = *this->active_;
+      this->pending_.name = "custom";
+      this->pending_dirty_ = true;
+    }
+    return this->pending_;
+  }
+
+  CommitResult commit_pending(const char **reason) {
+    *reason = nullptr;
+    if (!this->pending_dirty_) {
+      return COMMIT_NONE;
+    }
+    if (this->pending_.same_parameters(*this->active_)) {
+      this->pending_dirty_ = false;
+      return COMMIT_UNCHANGED;
+    }
+    *reason = this->install(this->pending_);
+    if (*reason != nullptr) {
+      return COMMIT_REJECTED;
+    }
+    return COMMIT_APPLIED;
+  }
+
+  // Validate and publish a whole profile into the inactive custom buffer; nullptr on success
+  const char *install(const EngineProfile &candidate) {
+    const char *reason = candidate.validate();
+    if (reason != nullptr) {
+      return reason;
+    }
+    this->custom_slot_ ^= 1;
+    this->custom_[this->custom_slot_] = candidate;
+    this->active_ = &this->custom_[this->custom_slot_];
+    this->pending_dirty_ = false;
+    this->generation_++;
+    return nullptr;
+  }
+
+ protected:
+  EngineProfile presets_[MAX_PRESETS];
+  size_t preset_count_{1};
+  EngineProfile custom_[2];
+  unsigned custom_slot_{0};
+  EngineProfile pending_;
+  bool pending_dirty_{false};
+  const EngineProfile *active_{&presets_[0]};
+  uint32_t generation_{0};
+};
+
+}  // namespace bed_presence_engine
+}  // namespace esphome
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+
+#include "energy_histogram.h"
+
+#ifndef BED_PRESENCE_Q_FRAC_BITS
+#define BED_PRESENCE_Q_FRAC_BITS 16
+#endif
+
+namespace esphome {
+namespace bed_presence_engine {
+
+/**
+ * Decision-path arithmetic policies.
+ *
+ * The engine's per-frame decision (distance weighting, z-score, thresholds)
+ * and its baseline μ/σ are written once against `DecisionMath`:
+ *
+ * - FloatMath (default): IEEE single precision, exactly the original code.
+ * - QMath<F> (BED_PRESENCE_FIXED_POINT): signed Q(31-F).F integers. Every
+ *   operation is integer add/multiply/divide with defined rounding, so a given
+ *   input stream yields the same decisions on any host or MCU, with no
+ *   dependence on FPU availability, fused multiply-add or libm.
+ *
+ * Inputs arrive as float (ESPHome sensor API) and are converted once per frame;
+ * LD2410 energies are integer percentages, so that conversion is exact.
+ * Parameters (k_on, k_off, window edges, margins) are converted when they
+ * change, so a frame never converts anything but its own readings.
+ */
+struct FloatMath {
+  using value_t = float;
+  using sum_t = float;  // Running sum of values (cadence block means)
+
+  static constexpr value_t SIGMA_EPSILON = 0.001f;  // z is 0 for σ at or below this
+
+  static constexpr value_t from_float(float value) { return value; }
+  static constexpr float to_float(value_t value) { return value; }
+  static value_t mul(value_t a, value_t b) { return a * b; }
+  static value_t z_score(value_t x, value_t mu, value_t sigma) { return (x - mu) / sigma; }
+  static value_t average(sum_t sum, uint32_t count) { return sum / static_cast<float>(count); }
+
+  // z × 100 for the black box, saturated to int16
+  static int16_t to_centi(value_t z) {
+    float centi = z * 100.0f;
+    return centi >= 32767.0f ? 32767 : (centi <= -32767.0f ? -32767 : static_cast<int16_t>(centi));
+  }
+
+  // Smoothstep falloff across the soft margin: 1 at the window edge, 0 at the margin edge
+  static value_t falloff(value_t outside, value_t margin) {
+    float t = outside / margin;
+    return 1.0f - t * t * (3.0f - 2.0f * t);
+  }
+
+  // Baseline plus `weight` of the evidence above it
+  static value_t blend(value_t mu, value_t weight, value_t x) { return mu + weight * (x - mu); }
+
+  // Median and MAD·1.4826 of a histogram; halves and quarters of integers are exact in float
+  static value_t histogram_median(const EnergyHistogram &histogram) {
+    return static_cast<float>(histogram.median_x2()) * 0.5f;
+  }
+  static value_t histogram_sigma(const EnergyHistogram &histogram) {
+    float mad = static_cast<float>(histogram.mad_x4(histogram.median_x2())) * 0.25f;
+    float sigma = mad * 1.4826f;
+    return sigma < 0.05f ? 0.05f : sigma;
+  }
+};
+
+// Round-to-nearest conversion into Q(31-F).F, saturating at ±(2^31 - 1)
+template <int FRAC_BITS> constexpr int32_t q_from_float(float value) {
+  return value >= 2147483520.0f / (1 << FRAC_BITS)
+             ? INT32_MAX
+             : (value <= -2147483520.0f / (1 << FRAC_BITS)
+                    ? -INT32_MAX
+                    : static_cast<int32_t>(value * (1 << FRAC_BITS) + (value >= 0.0f ? 0.5f : -0.5f)));
+}
+
+template <int FRAC_BITS> struct QMath {
+  // 8 bits keeps σ ≥ 0.05 representable; 20 bits still holds z up to ±2047
+  static_assert(FRAC_BITS >= 8 && FRAC_BITS <= 20, "Q format needs 8-20 fractional bits");
+
+  using value_t = int32_t;
+  using sum_t = int64_t;
+
+  static constexpr int32_t ONE = int32_t(1) << FRAC_BITS;
+  static constexpr value_t SIGMA_EPSILON = q_from_float<FRAC_BITS>(0.001f);
+  static constexpr value_t SIGMA_MIN = q_from_float<FRAC_BITS>(0.05f);     // Calibration floor on σ
+  static constexpr value_t MAD_TO_SIGMA = q_from_float<FRAC_BITS>(1.4826f);  // Normal-consistent MAD scale
+
+  static constexpr value_t from_float(float value) { return q_from_float<FRAC_BITS>(value); }
+  static constexpr float to_float(value_t value) { return static_cast<float>(value) / static_cast<float>(ONE); }
+
+  // Round half up
+  static value_t mul(value_t a, value_t b) {
+    return saturate((static_cast<int64_t>(a) * b + (int64_t(1) << (FRAC_BITS - 1))) >> FRAC_BITS);
+  }
+
+  // Truncates toward zero
+  static value_t div(value_t a, value_t b) { return saturate(static_cast<int64_t>(a) * ONE / b); }
+
+  static value_t z_score(value_t x, value_t mu, value_t sigma) { return div(x - mu, sigma); }
+
+  // Round half up (values are non-negative energies)
+  static value_t average(sum_t sum, uint32_t count) { return saturate((sum + count / 2) / count); }
+
+  // Truncates toward zero, like the float cast
+  static int16_t to_centi(value_t z) {
+    int64_t centi = static_cast<int64_t>(z) * 100 / ONE;
+    return centi >= 32767 ? 32767 : (centi <= -32767 ? -32767 : static_cast<int16_t>(centi));
+  }
+
+  static value_t falloff(value_t outside, value_t margin) {
+    value_t t = div(outside, margin);
+    return ONE - mul(mul(t, t), 3 * ONE - 2 * t);
+  }
+
+  static value_t blend(value_t mu, value_t weight, value_t x) { return mu + mul(weight, x - mu); }
+
+  // Baseline from a calibration histogram: the same median and MAD·1.4826 as the float sample path, exact
+  static value_t histogram_median(const EnergyHistogram &histogram) {
+    return histogram.median_x2() * (ONE / 2);
+  }
+  static value_t histogram_sigma(const EnergyHistogram &histogram) {
+    int64_t mad_x4 = histogram.mad_x4(histogram.median_x2());
+    value_t sigma = saturate((mad_x4 * MAD_TO_SIGMA + 2) >> 2);
+    if (sigma < SIGMA_MIN) {
+      return SIGMA_MIN;
+    }
+    return sigma;
+  }
+
+ protected:
+  static value_t saturate(int64_t value) {
+    return value > INT32_MAX ? INT32_MAX : (value < -INT32_MAX ? -INT32_MAX : static_cast<value_t>(value));
+  }
+};
+
+#ifdef BED_PRESENCE_FIXED_POINT
+using DecisionMath = QMath<BED_PRESENCE_Q_FRAC_BITS>;
+#else
+using DecisionMath = FloatMath;
+#endif
+using decision_t = DecisionMath::value_t;
+
+}  // namespace bed_presence_engine
+}  // namespace esphome
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace bed_presence_engine {
+
+static const int HMM_NUM_STATES = 5;
+
+// Mean dwell time per state (seconds)
+const float HMM_DWELL_S[HMM_NUM_STATES] = {3600.0f, 20.0f, 900.0f, 45.0f, 20.0f};
+// Successor distribution once a state is left (rows sum to 1, diagonal 0)
+const float HMM_NEXT[HMM_NUM_STATES][HMM_NUM_STATES] = {
+    {0.0f, 1.0f, 0.0f, 0.0f, 0.0f},    // EMPTY → entering
+    {0.1f, 0.0f, 0.4f, 0.5f, 0.0f},    // ENTERING → settled, or aborted
+    {0.0f, 0.0f, 0.0f, 0.95f, 0.05f},  // OCCUPIED_STILL → rolls over, rarely straight out
+    {0.0f, 0.0f, 0.8f, 0.0f, 0.2f},    // OCCUPIED_MOVING → still again, or getting up
+    {0.8f, 0.0f, 0.0f, 0.2f, 0.0f},    // LEAVING → empty, or lies back down
+};
+// P(moving energy above the restless threshold | state)
+const float HMM_P_MOVING[HMM_NUM_STATES] = {0.05f, 0.8f, 0.1f, 0.9f, 0.8f};
+
+/**
+ * Five-state hidden-Markov occupancy filter.
+ *
+ * Runs a normalized forward pass per frame over empty, entering,
+ * occupied-still, occupied-moving and leaving, and reports the posterior
+ * probability that the bed is not empty. Unlike the debounced binary output,
+ * the probability carries no fixed delay: consumers pick their own
+ * latency/accuracy trade-off by thresholding it.
+ *
+ * - Emissions: still-energy z-score is Gaussian per state (class means and
+ *   spreads come from calibration), mixed with a small outlier floor so one
+ *   stray frame cannot flip the posterior. Moving energy, when available,
+ *   contributes a binary "moving" observation.
+ * - Transitions: exponential dwell times in seconds, discretized with the
+ *   actual frame interval, so the filter behaves the same at any frame rate.
+ * - Evidence is scaled by frame interval / evidence period: a 60 Hz loop that
+ *   re-reads the same radar value accumulates no more evidence per second than
+ *   the radar provides. The default period (3 s) also reflects that LD2410
+ *   energies are smoothed, so neighbouring frames are far from independent.
+ */
+class OccupancyHmm {
+ public:
+  enum HiddenState { EMPTY, ENTERING, OCCUPIED_STILL, OCCUPIED_MOVING, LEAVING, NUM_STATES = HMM_NUM_STATES };
+
+  static constexpr float OUTLIER_DENSITY = 0.002f;  // Floor on every per-frame z likelihood
+  static constexpr float MIN_CLASS_SD = 0.5f;       // z units
+  static constexpr float MAX_EVIDENCE_WEIGHT = 10.0f;
+
+  OccupancyHmm() {
+    this->set_emissions(0.0f, 1.0f, 13.5f, 4.5f);
+    this->reset();
+  }
+
+  // Class-conditional still-energy z distributions (empty bed, occupied bed)
+  void set_emissions(float empty_mean, float empty_sd, float occupied_mean, float occupied_sd) {
+    empty_sd = std::fmax(empty_sd, MIN_CLASS_SD);
+    occupied_sd = std::fmax(occupied_sd, MIN_CLASS_SD);
+    this->mean_[EMPTY] = empty_mean;
+    this->sd_[EMPTY] = empty_sd;
+    this->mean_[OCCUPIED_STILL] = occupied_mean;
+    this->sd_[OCCUPIED_STILL] = occupied_sd;
+    this->mean_[OCCUPIED_MOVING] = occupied_mean;
+    this->sd_[OCCUPIED_MOVING] = 1.25f * occupied_sd;
+    // Getting in or out looks like an occupied bed; only motion and short dwell tell them apart
+    this->mean_[ENTERING] = occupied_mean;
+    this->sd_[ENTERING] = occupied_sd;
+    this->mean_[LEAVING] = occupied_mean;
+    this->sd_[LEAVING] = occupied_sd;
+  }
+
+  void set_evidence_period_ms(uint32_t ms) { this->evidence_period_ms_ = ms == 0 ? 1 : ms; }
+
+  void reset() {
+    for (int i = 0; i < NUM_STATES; ++i) {
+      this->p_[i] = 0.0f;
+    }
+    this->p_[EMPTY] = 1.0f;
+  }
+
+  /**
+   * Advance the filter by one frame.
+   *
+   * `moving` is 1/0 for moving energy above/below the restless threshold, or
+   * -1 when no moving-energy sensor is configured. Returns occupancy().
+   */
+  float update(float z, int moving, uint32_t dt_ms) {
+    // Predict: exponential dwell, leaving mass split over the successor row
+    float prior[NUM_STATES] = {};
+    float dt_s = static_cast<float>(dt_ms) / 1000.0f;
+    for (int i = 0; i < NUM_STATES; ++i) {
+      float stay = std::exp(-dt_s / HMM_DWELL_S[i]);
+      prior[i] += this->p_[i] * stay;
+      float leave = this->p_[i] * (1.0f - stay);
+      for (int j = 0; j < NUM_STATES; ++j) {
+        prior[j] += leave * HMM_NEXT[i][j];
+      }
+    }
+
+    // Update: likelihood tempered by how much radar time this frame represents
+    float weight = std::fmin(static_cast<float>(dt_ms) / static_cast<float>(this->evidence_period_ms_),
+                             MAX_EVIDENCE_WEIGHT);
+    float total = 0.0f;
+    for (int i = 0; i < NUM_STATES; ++i) {
+      float d = (z - this->mean_[i]) / this->sd_[i];
+      float likelihood = 0.3989423f * std::exp(-0.5f * d * d) / this->sd_[i] + OUTLIER_DENSITY;
+      if (moving >= 0) {
+        likelihood *= moving ? HMM_P_MOVING[i] : 1.0f - HMM_P_MOVING[i];
+      }
+      this->p_[i] = prior[i] * std::exp(weight * std::log(likelihood));
+      total += this->p_[i];
+    }
+
+    if (!(total > 0.0f) || !std::isfinite(total)) {
+      // Numerically lost (e.g. NaN input): fall back to the predicted distribution
+      total = 0.0f;
+      for (int i = 0; i < NUM_STATES; ++i) {
+        this->p_[i] = prior[i];
+        total += prior[i];
+      }
+    }
+    for (int i = 0; i < NUM_STATES; ++i) {
+      this->p_[i] /= total;
+    }
+    return this->occupancy();
+  }
+
+  // Posterior probability that someone is in (or getting into/out of) the bed
+  float occupancy() const { return 1.0f - this->p_[EMPTY]; }
+  float probability(HiddenState state) const { return this->p_[state]; }
+
+  HiddenState most_likely() const {
+    int best = EMPTY;
+    for (int i = 1; i < NUM_STATES; ++i) {
+      if (this->p_[i] > this->p_[best]) {
+        best = i;
+      }
+    }
+    return static_cast<HiddenState>(best);
+  }
+
+ protected:
+  float mean_[NUM_STATES];
+  float sd_[NUM_STATES];
+  float p_[NUM_STATES];
+  uint32_t evidence_period_ms_{3000};
+};
+
+}  // namespace bed_presence_engine
+}  // namespace esphome
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace bed_presence_engine {
+
+// Compact per-session record; durations in seconds/minutes so a night fits in 16 bytes
+struct SessionSummary {
+  uint32_t start_ms{0};      // millis() when the session started (first ON)
+  uint32_t span_s{0};        // First ON to final OFF
+  uint32_t in_bed_s{0};      // Time spent occupied within the span
+  uint16_t exits{0};         // OFF periods shorter than the exit grace (bathroom trips, etc.)
+  uint16_t restless_min{0};  // Occupied minutes with moving energy at/above the restless threshold
+};
+
+/**
+ * On-device sleep-session aggregation.
+ *
+ * Folds the occupancy stream into fixed-size counters instead of leaving
+ * Home Assistant to derive them from recorder history. A session opens on the
+ * first occupied frame and closes once the bed has been empty for longer than
+ * the exit grace; shorter absences count as exits. Closed sessions longer than
+ * the minimum span are kept in a bounded ring (newest first on read).
+ */
+class SleepSessionTracker {
+ public:
+  static constexpr size_t HISTORY_SIZE = 7;
+  static constexpr uint32_t MINUTE_MS = 60000;
+
+  void set_exit_grace_ms(uint32_t ms) { exit_grace_ms_ = ms; }
+  void set_min_session_ms(uint32_t ms) { min_session_ms_ = ms; }
+  void set_restless_threshold(float energy) { restless_threshold_ = energy; }
+
+  // Feed one frame; returns true when a session closed and was recorded (see last())
+  bool update(uint32_t now, bool occupied, float moving_energy) {
+    if (!this->active_) {
+      if (occupied) {
+        this->open(now);
+      }
+      return false;
+    }
+
+    if (occupied) {
+      if (this->out_) {
+        this->out_ = false;
+        this->occupied_since_ = now;
+        this->minute_start_ = now;
+        this->minute_restless_ = false;
+        this->current_.exits++;
+      }
+      if (now - this->minute_start_ >= MINUTE_MS) {
+        this->close_minute();
+        this->minute_start_ = now;
+      }
+      if (moving_energy >= this->restless_threshold_) {
+        this->minute_restless_ = true;
+      }
+      return false;
+    }
+
+    if (!this->out_) {
+      this->out_ = true;
+      this->out_since_ = now;
+      this->current_.in_bed_s += (now - this->occupied_since_) / 1000;
+      this->close_minute();
+      return false;
+    }
+
+    if (now - this->out_since_ < this->exit_grace_ms_) {
+      return false;
+    }
+
+    // Absence outlasted the grace: session ended when the bed was last vacated
+    this->active_ = false;
+    this->current_.span_s = (this->out_since_ - this->current_.start_ms) / 1000;
+    if (static_cast<uint64_t>(this->current_.span_s) * 1000 < this->min_session_ms_) {
+      return false;
+    }
+
+    this->history_[this->head_] = this->current_;
+    this->head_ = (this->head_ + 1) % HISTORY_SIZE;
+    if (this->count_ < HISTORY_SIZE) {
+      this->count_++;
+    }
+    return true;
+  }
+
+  float restless_threshold() const { return this->restless_threshold_; }
+  bool in_session() const { return this->active_; }
+  size_t history_size() const { return this->count_; }
+
+  // index 0 is the most recently closed session
+  const SessionSummary &history(size_t index) const {
+    return this->history_[(this->head_ + HISTORY_SIZE - 1 - index) % HISTORY_SIZE];
+  }
+  const SessionSummary &last() const { return this->history(0); }
+
+ protected:
+  void open(uint32_t now) {
+    this->active_ = true;
+    this->out_ = false;
+    this->current_ = SessionSummary();
+    this->current_.start_ms = now;
+    this->occupied_since_ = now;
+    this->minute_start_ = now;
+    this->minute_restless_ = false;
+  }
+
+  void close_minute() {
+    if (this->minute_restless_) {
+      this->current_.restless_min++;
+      this->minute_restless_ = false;
+    }
+  }
+
+  uint32_t exit_grace_ms_{15 * 60 * 1000};
+  uint32_t min_session_ms_{10 * 60 * 1000};
+  float restless_threshold_{30.0f};
+
+  bool active_{false};
+  bool out_{false};
+  uint32_t occupied_since_{0};
+  uint32_t out_since_{0};
+  uint32_t minute_start_{0};
+  bool minute_restless_{false};
+  SessionSummary current_;
+
+  SessionSummary history_[HISTORY_SIZE];
+  size_t head_{0};
+  size_t count_{0};
+};
+
+}  // namespace bed_presence_engine
+}  // namespace esphome
@@ -0,0 +1,24 @@
+#pragma once
+
+/**
+ * Native stand-in for esphome/components/binary_sensor/binary_sensor.h.
+ */
+
+#include <cstdint>
+
+namespace esphome {
+namespace binary_sensor {
+
+class BinarySensor {
+public:
+    void publish_state(bool state) {
+        this->state = state;
+        this->publish_count++;
+    }
+
+    bool state{false};
+    uint32_t publish_count{0};
+};
+
+}  // namespace binary_sensor
+}  // namespace esphome
@@ -0,0 +1,27 @@
+#pragma once
+
+/**
+ * Native stand-in for esphome/core/component.h (only what the engine uses).
+ */
+
+#include <cstdint>
+#include <string>
+
+#include "esphome/core/hal.h"
+
+namespace esphome {
+
+namespace setup_priority {
+const float DATA = 600.0f;
+}  // namespace setup_priority
+
+class Component {
+public:
+    virtual ~Component() = default;
+    virtual void setup() {}
+    virtual void loop() {}
+    virtual void dump_config() {}
+    virtual float get_setup_priority() const { return 0.0f; }
+};
+
+}  // namespace esphome
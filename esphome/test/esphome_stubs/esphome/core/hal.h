@@ -0,0 +1,24 @@
+#pragma once
+
+/**
+ * Native stand-in for esphome/core/hal.h: millis() reads a per-thread mock
+ * clock so replay workers running in parallel each own their timeline.
+ */
+
+#include <cstdint>
+
+namespace esphome {
+namespace stub {
+
+inline uint32_t &clock_ms() {
+    static thread_local uint32_t now = 0;
+    return now;
+}
+
+inline void set_millis(uint32_t now) { clock_ms() = now; }
+
+}  // namespace stub
+
+inline uint32_t millis() { return stub::clock_ms(); }
+
+}  // namespace esphome
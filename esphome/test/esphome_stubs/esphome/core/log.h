@@ -0,0 +1,28 @@
+#pragma once
+
+/**
+ * Native stand-in for esphome/core/log.h. Log calls are discarded, but the
+ * format strings are still checked against their arguments.
+ */
+
+namespace esphome {
+namespace stub {
+
+#if defined(__GNUC__)
+__attribute__((format(printf, 2, 3)))
+#endif
+inline void log(const char *tag, const char *format, ...) {
+    (void) tag;
+    (void) format;
+}
+
+}  // namespace stub
+}  // namespace esphome
+
+#define ESP_LOGE(tag, ...) ::esphome::stub::log(tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ::esphome::stub::log(tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ::esphome::stub::log(tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ::esphome::stub::log(tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ::esphome::stub::log(tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ::esphome::stub::log(tag, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...) ::esphome::stub::log(tag, __VA_ARGS__)
@@ -0,0 +1,329 @@
+#pragma once
+
+/**
+ * Native model of the Bed Presence Engine shared by the unit tests and the
+ * synthetic scenario corpus.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "cadence_controller.h"
+#include "calibration_quality.h"
+#include "energy_histogram.h"
+#include "occupancy_hmm.h"
+
+/**
+ * Simplified Phase 2 Presence Engine for Testing
+ *
+ * This models the core Phase 2 logic without ESPHome dependencies:
+ * - Z-score calculation
+ * - 4-state machine (IDLE, DEBOUNCING_ON, PRESENT, DEBOUNCING_OFF)
+ * - Debounce timers with time mocking
+ * - Absolute clear delay
+ *
+ * process_frame() follows BedPresenceEngine::loop() step for step (calibration
+ * expiry, cadence, distance gate, calibration sample, state machine);
+ * test_replay_equivalence.cpp holds the two to bit-identical transitions.
+ */
+class SimplePresenceEngine {
+public:
+    // State machine states
+    enum State { IDLE, DEBOUNCING_ON, PRESENT, DEBOUNCING_OFF };
+    enum GateMode { GATE_HARD, GATE_ZERO_EVIDENCE, GATE_SOFT };
+
+    // Configuration (matching actual implementation defaults)
+    float mu_still_ = 100.0f;
+    float sigma_still_ = 20.0f;
+    float k_on_ = 4.0f;
+    float k_off_ = 2.0f;
+    unsigned long on_debounce_ms_ = 3000;
+    unsigned long off_debounce_ms_ = 5000;
+    unsigned long abs_clear_delay_ms_ = 30000;
+    float d_min_cm_ = 0.0f;
+    float d_max_cm_ = 600.0f;
+    GateMode gate_mode_ = GATE_HARD;
+    float soft_margin_cm_ = 50.0f;
+
+    // Adaptive idle cadence (decimation 1 = every frame)
+    esphome::bed_presence_engine::CadenceController cadence_;
+    float cadence_wake_margin_ = 3.0f;
+
+    // Optional HMM occupancy probability (runs alongside the state machine)
+    esphome::bed_presence_engine::OccupancyHmm occupancy_;
+    bool occupancy_enabled_ = false;
+    float moving_energy_ = -1.0f;  // Negative: no moving-energy sensor
+    float restless_threshold_ = 30.0f;
+    unsigned long occupancy_last_time_ = 0;
+    bool occupancy_started_ = false;
+
+    // Gate decision counters
+    unsigned long frames_in_window_ = 0;
+    unsigned long frames_attenuated_ = 0;
+    unsigned long frames_out_of_window_ = 0;
+
+    // State
+    State current_state_ = IDLE;
+    bool binary_output_ = false;  // Simulates binary sensor output
+    std::string last_reason_ = "";
+
+    // Time tracking (mock time for testing)
+    unsigned long mock_time_ = 0;
+    unsigned long debounce_start_time_ = 0;
+    unsigned long last_high_confidence_time_ = 0;
+    bool calibrating_ = false;
+    unsigned long calibration_end_time_ = 0;
+    std::vector<float> calibration_samples_;  // Sorted-sample reference for the device's histogram median/MAD
+
+    // Baseline session quality gating (same limits and retry policy as the device)
+    esphome::bed_presence_engine::CalibrationQuality calibration_quality_;
+    esphome::bed_presence_engine::CalibrationQualityLimits calibration_limits_;
+    esphome::bed_presence_engine::EnergyHistogram calibration_histogram_;
+    uint32_t calibration_duration_s_ = 0;
+    uint8_t calibration_max_retries_ = 1;
+    uint8_t calibration_retries_left_ = 0;
+
+    // Z-score calculation: z = (x - μ) / σ
+    float calculate_z_score(float energy) {
+        if (sigma_still_ <= 0.001f) {
+            return 0.0f;  // Prevent division by zero
+        }
+        return (energy - mu_still_) / sigma_still_;
+    }
+
+    // Advance mock time
+    void advance_time(unsigned long ms) {
+        mock_time_ += ms;
+    }
+
+    static float compute_median(std::vector<float> values) {
+        if (values.empty()) {
+            return 0.0f;
+        }
+
+        size_t mid = values.size() / 2;
+        std::nth_element(values.begin(), values.begin() + mid, values.end());
+        float median = values[mid];
+
+        if (values.size() % 2 == 0) {
+            std::nth_element(values.begin(), values.begin() + mid - 1, values.end());
+            median = (median + values[mid - 1]) / 2.0f;
+        }
+        return median;
+    }
+
+    void finalize_calibration(bool allow_retry = true) {
+        calibrating_ = false;
+        if (calibration_samples_.empty()) {
+            return;
+        }
+
+        auto samples = calibration_samples_;
+        calibration_samples_.clear();
+
+        float median = compute_median(samples);
+        std::vector<float> deviations(samples.size());
+        for (size_t i = 0; i < samples.size(); ++i) {
+            deviations[i] = std::fabs(samples[i] - median);
+        }
+        float mad = compute_median(deviations);
+        float sigma = mad * 1.4826f;
+        if (sigma < 0.05f) {
+            sigma = 0.05f;
+        }
+
+        esphome::bed_presence_engine::CalibrationQualityReport report =
+            calibration_quality_.evaluate(static_cast<uint32_t>(mock_time_), calibration_histogram_, median, sigma,
+                                          calibration_limits_);
+        if (report.failure != nullptr) {
+            // Bad session: retry transient problems, otherwise keep the previous μ/σ
+            if (allow_retry && report.retryable() && calibration_retries_left_ > 0) {
+                uint8_t retries_left = calibration_retries_left_ - 1;
+                start_calibration(calibration_duration_s_);
+                calibration_retries_left_ = retries_left;
+            }
+            return;
+        }
+
+        mu_still_ = median;
+        sigma_still_ = sigma;
+        configure_occupancy();
+    }
+
+    // Occupied-class emission defaults derived from k_on (no occupied calibration in the model)
+    void configure_occupancy() {
+        occupancy_.set_emissions(0.0f, 1.0f, 2.0f * k_on_ - k_off_, 0.5f * (k_on_ - k_off_));
+    }
+
+    void update_occupancy(float z_still) {
+        if (!occupancy_enabled_) {
+            return;
+        }
+        uint32_t dt = occupancy_started_ ? static_cast<uint32_t>(mock_time_ - occupancy_last_time_) : 1000;
+        occupancy_started_ = true;
+        occupancy_last_time_ = mock_time_;
+        int moving = moving_energy_ < 0.0f ? -1 : (moving_energy_ >= restless_threshold_ ? 1 : 0);
+        occupancy_.update(z_still, moving, dt);
+    }
+
+    void start_calibration(uint32_t duration_s) {
+        if (duration_s == 0) {
+            return;
+        }
+        uint32_t clamped = std::min<uint32_t>(duration_s, 600);
+        calibrating_ = true;
+        calibration_samples_.clear();
+        calibration_end_time_ = mock_time_ + clamped * 1000UL;
+        calibration_duration_s_ = clamped;
+        calibration_retries_left_ = calibration_max_retries_;
+        calibration_histogram_.clear();
+        calibration_quality_.start(static_cast<uint32_t>(mock_time_), clamped * 1000UL);
+    }
+
+    void stop_calibration() {
+        if (calibrating_) {
+            finalize_calibration(false);
+        }
+    }
+
+    // In-window frame while calibrating
+    void collect_calibration(float energy) {
+        if (!calibrating_) {
+            return;
+        }
+        calibration_quality_.add_sample(static_cast<uint32_t>(mock_time_), energy);
+        calibration_samples_.push_back(energy);
+        calibration_histogram_.add(energy);
+        if (mock_time_ >= calibration_end_time_) {
+            finalize_calibration();
+        }
+    }
+
+    // Distance membership: 1 inside the window, smoothstep falloff across the soft margin
+    float distance_weight(float distance) const {
+        float outside;
+        if (distance < d_min_cm_) {
+            outside = d_min_cm_ - distance;
+        } else if (distance > d_max_cm_) {
+            outside = distance - d_max_cm_;
+        } else {
+            return 1.0f;
+        }
+        if (gate_mode_ != GATE_SOFT || outside >= soft_margin_cm_) {
+            return 0.0f;
+        }
+        float t = outside / soft_margin_cm_;
+        return 1.0f - t * t * (3.0f - 2.0f * t);
+    }
+
+    // One component loop iteration: calibration expiry, cadence, gate decision, calibration sample, state machine
+    void process_frame(float energy, float distance) {
+        if (calibrating_ && mock_time_ >= calibration_end_time_) {
+            finalize_calibration();
+        }
+
+        float wake_energy = mu_still_ + sigma_still_ * (k_on_ - cadence_wake_margin_);
+        if (!cadence_.admit(energy, current_state_ == IDLE && !calibrating_, wake_energy)) {
+            return;
+        }
+
+        float weight = distance_weight(distance);
+        if (weight >= 1.0f) {
+            frames_in_window_++;
+            // Calibration only learns from frames inside the bed zone
+            collect_calibration(energy);
+        } else {
+            if (weight > 0.0f) {
+                frames_attenuated_++;
+            } else {
+                frames_out_of_window_++;
+            }
+            if (calibrating_) {
+                calibration_quality_.add_rejected();
+            }
+            if (gate_mode_ == GATE_HARD) {
+                return;
+            }
+            energy = mu_still_ + weight * (energy - mu_still_);
+        }
+
+        process_energy(energy);
+    }
+
+    // State machine step for one (already gated) energy reading
+    void process_energy(float energy, bool distance_allowed = true) {
+        if (!distance_allowed) {
+            return;
+        }
+
+        float z_still = calculate_z_score(energy);
+        unsigned long now = mock_time_;
+
+        update_occupancy(z_still);
+
+        switch (current_state_) {
+            case IDLE:
+                if (z_still >= k_on_) {
+                    debounce_start_time_ = now;
+                    current_state_ = DEBOUNCING_ON;
+                }
+                break;
+
+            case DEBOUNCING_ON:
+                if (z_still >= k_on_) {
+                    // Condition still holds, check timer
+                    if ((now - debounce_start_time_) >= on_debounce_ms_) {
+                        current_state_ = PRESENT;
+                        last_high_confidence_time_ = now;
+                        binary_output_ = true;
+
+                        char buf[64];
+                        snprintf(buf, sizeof(buf), "ON: z=%.2f, debounced %lums", z_still, on_debounce_ms_);
+                        last_reason_ = buf;
+                    }
+                } else {
+                    // Condition lost, abort debounce
+                    current_state_ = IDLE;
+                }
+                break;
+
+            case PRESENT:
+                // Update high confidence timestamp whenever strong signal detected
+                if (z_still > k_on_) {
+                    last_high_confidence_time_ = now;
+                }
+
+                // Check for transition to DEBOUNCING_OFF
+                if (z_still < k_off_) {
+                    // Low signal detected, check absolute clear delay
+                    if ((now - last_high_confidence_time_) >= abs_clear_delay_ms_) {
+                        debounce_start_time_ = now;
+                        current_state_ = DEBOUNCING_OFF;
+                    }
+                }
+                break;
+
+            case DEBOUNCING_OFF:
+                if (z_still < k_off_) {
+                    // Condition still holds, check timer
+                    if ((now - debounce_start_time_) >= off_debounce_ms_) {
+                        current_state_ = IDLE;
+                        binary_output_ = false;
+
+                        char buf[64];
+                        snprintf(buf, sizeof(buf), "OFF: z=%.2f, debounced %lums", z_still, off_debounce_ms_);
+                        last_reason_ = buf;
+                    }
+                } else if (z_still >= k_on_) {
+                    // High signal returned, abort debounce
+                    current_state_ = PRESENT;
+                    last_high_confidence_time_ = now;
+                }
+                break;
+        }
+    }
+};
@@ -0,0 +1,410 @@
+#pragma once
+
+/**
+ * Deterministic synthetic LD2410 scenario generator
+ *
+ * Streams still/moving energy and still-distance frames with ground-truth
+ * occupancy labels so engine changes can be judged on latency and accuracy
+ * over large corpora instead of a handful of hand-written constants.
+ *
+ * - Empty-bed still energy follows the production baseline (μ=6.7, σ=3.5)
+ *   with a slow mean-reverting drift; values are integer percentages like the
+ *   LD2410 reports.
+ * - Interferers (HVAC bursts, pets) and sleep behaviour (restless bursts,
+ *   still-energy fades, getting up at night) are two-state burst processes.
+ * - Every stream is a pure function of (kind, seed, config): generation is
+ *   streaming (constant memory) and safe to run on many threads at once.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace radar_scenario {
+
+// splitmix64-seeded xorshift64* stream
+class Rng {
+public:
+    explicit Rng(uint64_t seed) : state_(splitmix(seed) | 1) {}
+
+    static uint64_t splitmix(uint64_t x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    // [0, 1)
+    float uniform() { return static_cast<float>(next() >> 40) * (1.0f / 16777216.0f); }
+    float uniform(float lo, float hi) { return lo + (hi - lo) * uniform(); }
+    bool chance(float p) { return uniform() < p; }
+
+    // Standard normal via Box-Muller, caching the second variate
+    float normal() {
+        if (has_spare_) {
+            has_spare_ = false;
+            return spare_;
+        }
+        float u1 = std::max(uniform(), 1e-7f);
+        float u2 = uniform();
+        float r = std::sqrt(-2.0f * std::log(u1));
+        spare_ = r * std::sin(6.2831853f * u2);
+        has_spare_ = true;
+        return r * std::cos(6.2831853f * u2);
+    }
+
+private:
+    uint64_t state_;
+    float spare_ = 0.0f;
+    bool has_spare_ = false;
+};
+
+enum ScenarioKind {
+    EMPTY_DRIFT,     // Empty bed, baseline drifting over hours
+    HVAC_BURSTS,     // Empty bed, periodic HVAC/fan energy away from the bed
+    PET_VISITS,      // Empty bed, a cat/dog occasionally lying on it
+    DEEP_SLEEP,      // Person asleep all night, rare movement
+    RESTLESS_SLEEP,  // Person asleep, frequent movement bursts
+    NIGHT_WAKE,      // Person asleep, gets up one to three times
+    NUM_SCENARIO_KINDS
+};
+
+inline const char *scenario_name(ScenarioKind kind) {
+    switch (kind) {
+        case EMPTY_DRIFT: return "empty_drift";
+        case HVAC_BURSTS: return "hvac_bursts";
+        case PET_VISITS: return "pet_visits";
+        case DEEP_SLEEP: return "deep_sleep";
+        case RESTLESS_SLEEP: return "restless_sleep";
+        case NIGHT_WAKE: return "night_wake";
+        default: return "unknown";
+    }
+}
+
+struct Frame {
+    uint32_t t_ms;
+    float still_energy;   // LD2410 still energy (%)
+    float moving_energy;  // LD2410 moving energy (%)
+    float distance_cm;    // LD2410 still distance
+    bool occupied;        // Ground truth: a person is in the bed
+};
+
+struct ScenarioConfig {
+    uint32_t duration_ms = 8UL * 3600UL * 1000UL;
+    uint32_t frame_ms = 1000;  // ESPHome ld2410 default throttle
+    float bed_distance_cm = 120.0f;
+    float hvac_distance_cm = 350.0f;
+    float empty_mu = 6.7f;
+    float empty_sigma = 3.5f;
+};
+
+// Two-state (off/on) process with exponential dwell times
+class BurstProcess {
+public:
+    BurstProcess() = default;
+    BurstProcess(float mean_off_ms, float mean_on_ms) : mean_off_ms_(mean_off_ms), mean_on_ms_(mean_on_ms) {}
+
+    bool step(Rng &rng, uint32_t frame_ms) {
+        if (mean_on_ms_ <= 0.0f) {
+            return false;
+        }
+        float p = static_cast<float>(frame_ms) / (on_ ? mean_on_ms_ : mean_off_ms_);
+        if (rng.chance(p)) {
+            on_ = !on_;
+            if (on_) {
+                amplitude_ = rng.uniform(0.6f, 1.4f);
+            }
+        }
+        return on_;
+    }
+
+    bool on() const { return on_; }
+    float amplitude() const { return amplitude_; }
+
+private:
+    float mean_off_ms_ = 0.0f;
+    float mean_on_ms_ = 0.0f;
+    bool on_ = false;
+    float amplitude_ = 1.0f;
+};
+
+class ScenarioGenerator {
+public:
+    ScenarioGenerator(ScenarioKind kind, uint64_t seed, const ScenarioConfig &config = ScenarioConfig())
+        : kind_(kind), config_(config), rng_(seed * NUM_SCENARIO_KINDS + kind) {
+        const float minute = 60000.0f;
+        switch (kind) {
+            case HVAC_BURSTS:
+                interferer_ = BurstProcess(18 * minute, 4 * minute);
+                break;
+            case PET_VISITS:
+                interferer_ = BurstProcess(60 * minute, 6 * minute);
+                break;
+            case RESTLESS_SLEEP:
+                movement_ = BurstProcess(6 * minute, 45000.0f);
+                break;
+            default:
+                movement_ = BurstProcess(45 * minute, 20000.0f);
+                break;
+        }
+        fade_ = BurstProcess(40 * minute, 40000.0f);
+        drift_ = rng_.normal() * 1.5f;
+        build_timeline();
+    }
+
+    ScenarioKind kind() const { return kind_; }
+
+    // Produces the next frame; returns false once the scenario duration is exhausted
+    bool next(Frame &frame) {
+        if (t_ms_ >= config_.duration_ms) {
+            return false;
+        }
+        while (segment_ + 1 < boundaries_.size() && t_ms_ >= boundaries_[segment_ + 1]) {
+            segment_++;
+        }
+
+        // Mean-reverting baseline drift (τ = 2h, stationary σ ≈ 1.5)
+        const float tau_ms = 2.0f * 3600.0f * 1000.0f;
+        float a = static_cast<float>(config_.frame_ms) / tau_ms;
+        drift_ += -drift_ * a + 1.5f * std::sqrt(2.0f * a) * rng_.normal();
+
+        bool occupied = (segment_ % 2) == 1;  // Timeline alternates vacant/occupied
+        frame.t_ms = t_ms_;
+        frame.occupied = occupied;
+        if (occupied) {
+            occupied_frame(frame);
+        } else {
+            vacant_frame(frame);
+        }
+        frame.still_energy = quantize(frame.still_energy);
+        frame.moving_energy = quantize(frame.moving_energy);
+
+        t_ms_ += config_.frame_ms;
+        return true;
+    }
+
+private:
+    static float quantize(float energy) { return std::round(std::min(100.0f, std::max(0.0f, energy))); }
+
+    // Segment boundaries: [0, b1) vacant, [b1, b2) occupied, [b2, b3) vacant, ...
+    void build_timeline() {
+        boundaries_.push_back(0);
+        if (kind_ == EMPTY_DRIFT || kind_ == HVAC_BURSTS || kind_ == PET_VISITS) {
+            return;
+        }
+
+        const float minute = 60000.0f;
+        float duration = static_cast<float>(config_.duration_ms);
+        float enter = rng_.uniform(5 * minute, 30 * minute);
+        float leave = duration - rng_.uniform(10 * minute, 30 * minute);
+        boundaries_.push_back(static_cast<uint32_t>(enter));
+
+        if (kind_ == NIGHT_WAKE) {
+            int wakes = 1 + static_cast<int>(rng_.uniform() * 3.0f);
+            float slot = (leave - enter) / static_cast<float>(wakes + 1);
+            for (int i = 1; i <= wakes; ++i) {
+                float out = enter + slot * static_cast<float>(i) + rng_.uniform(-0.2f, 0.2f) * slot;
+                float back = out + rng_.uniform(3 * minute, 12 * minute);
+                boundaries_.push_back(static_cast<uint32_t>(out));
+                boundaries_.push_back(static_cast<uint32_t>(back));
+            }
+        }
+        boundaries_.push_back(static_cast<uint32_t>(leave));
+    }
+
+    void vacant_frame(Frame &frame) {
+        frame.still_energy = config_.empty_mu + drift_ + config_.empty_sigma * rng_.normal();
+        frame.moving_energy = std::fabs(rng_.normal()) * 3.0f + 1.0f;
+        frame.distance_cm = rng_.uniform(0.0f, 600.0f);  // No target: distance wanders across gates
+
+        if (interferer_.step(rng_, config_.frame_ms)) {
+            float amp = interferer_.amplitude();
+            if (kind_ == HVAC_BURSTS) {
+                frame.still_energy += 18.0f * amp + 4.0f * rng_.normal();
+                frame.moving_energy += 15.0f * amp + 5.0f * rng_.normal();
+                frame.distance_cm = config_.hvac_distance_cm + 20.0f * rng_.normal();
+            } else {
+                frame.still_energy = 26.0f * amp + 6.0f * rng_.normal();
+                frame.moving_energy = (rng_.chance(0.2f) ? 35.0f : 8.0f) + 8.0f * rng_.normal();
+                frame.distance_cm = config_.bed_distance_cm + 40.0f * rng_.normal();
+            }
+        }
+    }
+
+    void occupied_frame(Frame &frame) {
+        uint32_t segment_start = boundaries_[segment_];
+        uint32_t segment_end = segment_ + 1 < boundaries_.size() ? boundaries_[segment_ + 1] : config_.duration_ms;
+        bool settling = t_ms_ - segment_start < 30000 || segment_end - t_ms_ <= 20000;  // Getting in/out of bed
+
+        frame.distance_cm = config_.bed_distance_cm + 8.0f * rng_.normal();
+        bool moving = movement_.step(rng_, config_.frame_ms);
+        bool fading = fade_.step(rng_, config_.frame_ms);
+
+        if (settling) {
+            frame.still_energy = 40.0f + 12.0f * rng_.normal();
+            frame.moving_energy = 60.0f + 15.0f * rng_.normal();
+        } else if (moving) {
+            frame.still_energy = 35.0f + 12.0f * rng_.normal();
+            frame.moving_energy = 55.0f * movement_.amplitude() + 15.0f * rng_.normal();
+        } else if (fading) {
+            // Lying very still: the LD2410 still energy sags toward the noise floor
+            frame.still_energy = 22.0f + 6.0f * rng_.normal();
+            frame.moving_energy = 3.0f + 2.0f * rng_.normal();
+        } else {
+            frame.still_energy = 58.0f + 9.0f * rng_.normal();
+            frame.moving_energy = 5.0f + 3.0f * rng_.normal();
+        }
+    }
+
+    ScenarioKind kind_;
+    ScenarioConfig config_;
+    Rng rng_;
+    BurstProcess interferer_;
+    BurstProcess movement_;
+    BurstProcess fade_;
+    float drift_ = 0.0f;
+    std::vector<uint32_t> boundaries_;
+    size_t segment_ = 0;
+    uint32_t t_ms_ = 0;
+};
+
+/**
+ * Accuracy + latency score of an engine against ground truth.
+ *
+ * Onset latency runs from a label OFF→ON edge to the engine's next ON output
+ * (missed if the label drops first); offset latency mirrors it. An engine
+ * OFF→ON edge while the bed is empty counts as a false ON.
+ */
+struct Score {
+    uint64_t frames = 0;
+    uint64_t correct = 0;
+    uint32_t onsets = 0;
+    uint32_t detected_onsets = 0;
+    uint64_t on_latency_ms_total = 0;
+    uint32_t on_latency_ms_max = 0;
+    uint32_t offsets = 0;
+    uint32_t detected_offsets = 0;
+    uint64_t off_latency_ms_total = 0;
+    uint32_t off_latency_ms_max = 0;
+    uint32_t false_on_events = 0;
+
+    void merge(const Score &other) {
+        frames += other.frames;
+        correct += other.correct;
+        onsets += other.onsets;
+        detected_onsets += other.detected_onsets;
+        on_latency_ms_total += other.on_latency_ms_total;
+        on_latency_ms_max = std::max(on_latency_ms_max, other.on_latency_ms_max);
+        offsets += other.offsets;
+        detected_offsets += other.detected_offsets;
+        off_latency_ms_total += other.off_latency_ms_total;
+        off_latency_ms_max = std::max(off_latency_ms_max, other.off_latency_ms_max);
+        false_on_events += other.false_on_events;
+    }
+
+    double accuracy() const { return frames == 0 ? 1.0 : static_cast<double>(correct) / frames; }
+    double mean_on_latency_s() const {
+        return detected_onsets == 0 ? 0.0 : on_latency_ms_total / 1000.0 / detected_onsets;
+    }
+    double mean_off_latency_s() const {
+        return detected_offsets == 0 ? 0.0 : off_latency_ms_total / 1000.0 / detected_offsets;
+    }
+};
+
+// Replays one scenario through `step(frame) -> bool engine_output`
+template <typename Step>
+Score score_scenario(ScenarioGenerator &generator, Step &&step) {
+    Score score;
+    Frame frame;
+    bool label = false;
+    bool output = false;
+    bool onset_pending = false;
+    bool offset_pending = false;
+    uint32_t edge_time = 0;
+
+    while (generator.next(frame)) {
+        if (frame.occupied != label) {
+            label = frame.occupied;
+            edge_time = frame.t_ms;
+            onset_pending = label;
+            offset_pending = !label;
+            if (label) {
+                score.onsets++;
+            } else {
+                score.offsets++;
+            }
+        }
+
+        bool next_output = step(frame);
+        if (next_output && !output) {
+            if (onset_pending) {
+                uint32_t latency = frame.t_ms - edge_time;
+                score.detected_onsets++;
+                score.on_latency_ms_total += latency;
+                score.on_latency_ms_max = std::max(score.on_latency_ms_max, latency);
+                onset_pending = false;
+            } else if (!label) {
+                score.false_on_events++;
+            }
+        } else if (!next_output && output && offset_pending) {
+            uint32_t latency = frame.t_ms - edge_time;
+            score.detected_offsets++;
+            score.off_latency_ms_total += latency;
+            score.off_latency_ms_max = std::max(score.off_latency_ms_max, latency);
+            offset_pending = false;
+        }
+        output = next_output;
+
+        score.frames++;
+        if (output == label) {
+            score.correct++;
+        }
+    }
+    return score;
+}
+
+/**
+ * Scores `count` scenarios of one kind (seeds base_seed .. base_seed+count-1)
+ * across worker threads. `make_step()` must return a fresh engine callable per
+ * scenario; results are independent of the thread count.
+ */
+template <typename MakeStep>
+Score run_corpus(ScenarioKind kind, uint64_t base_seed, uint32_t count, const ScenarioConfig &config,
+                 MakeStep make_step, unsigned threads = 0) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min<unsigned>(threads, std::max<uint32_t>(count, 1));
+
+    std::atomic<uint32_t> next_index(0);
+    std::vector<Score> partial(threads);
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < threads; ++w) {
+        workers.emplace_back([&, w]() {
+            for (uint32_t i = next_index++; i < count; i = next_index++) {
+                ScenarioGenerator generator(kind, base_seed + i, config);
+                auto step = make_step();
+                partial[w].merge(score_scenario(generator, step));
+            }
+        });
+    }
+
+    Score total;
+    for (unsigned w = 0; w < threads; ++w) {
+        workers[w].join();
+        total.merge(partial[w]);
+    }
+    return total;
+}
+
+}  // namespace radar_scenario
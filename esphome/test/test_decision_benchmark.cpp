@@ -0,0 +1,205 @@
+/**
+ * Decision Math Benchmark
+ *
+ * Times the real per-frame path, BedPresenceEngine::loop() (soft distance
+ * gate, evidence blend, z-score, k_on/k_off hysteresis, black box, session
+ * tracker), against the ESPHome stubs, and the end-of-session baseline
+ * calibration against the sorted sample buffer it replaced. Both use the
+ * build's DecisionMath: run the `native` and `native_fixed` environments to
+ * compare float with Q format (`BED_PRESENCE_Q_FRAC_BITS`). Prints one
+ * `[bench]` line per measurement; only decisions are asserted, timings are
+ * informational.
+ *
+ * BED_PRESENCE_BENCH_FRAMES sets the stream length (default 1000000). Host
+ * ratios understate the gap on FPU-less targets (ESP32-C3, ESP8266), where
+ * every float operation is a soft-float library call.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bed_presence.h"
+#include "energy_histogram.h"
+#include "fixed_point.h"
+
+using esphome::bed_presence_engine::BedPresenceEngine;
+using esphome::bed_presence_engine::BlackBoxStorage;
+using esphome::bed_presence_engine::DecisionMath;
+using esphome::bed_presence_engine::EnergyHistogram;
+
+namespace {
+
+struct BenchFrame {
+    float energy;
+    float distance_cm;
+};
+
+constexpr uint32_t FRAME_MS = 100;        // LD2410 engineering-mode rate
+constexpr uint32_t MINUTE_FRAMES = 600;   // Occupancy alternates every minute
+constexpr float D_MAX_CM = 300.0f;
+constexpr float SOFT_MARGIN_CM = 40.0f;
+
+#ifdef BED_PRESENCE_FIXED_POINT
+constexpr float SIGMA_TOLERANCE = 2.0f / (1 << BED_PRESENCE_Q_FRAC_BITS);
+#else
+constexpr float SIGMA_TOLERANCE = 0.0f;
+#endif
+
+// The component as configured on a device: energy and distance sensors, soft gate, black box attached
+class BenchEngine : public BedPresenceEngine {
+public:
+    BenchEngine() {
+        esphome::stub::set_millis(this->now_ms_);
+        this->black_box_.attach(&this->black_box_memory_);
+        this->set_energy_sensor(&this->energy_);
+        this->set_distance_sensor(&this->distance_);
+        this->set_d_max_cm(D_MAX_CM);
+        this->set_distance_gate_mode(esphome::bed_presence_engine::GATE_SOFT);
+        this->set_distance_soft_margin_cm(SOFT_MARGIN_CM);
+        this->setup();
+    }
+
+    bool frame(const BenchFrame &f) {
+        this->energy_.publish_state(f.energy);
+        this->distance_.publish_state(f.distance_cm);
+        this->now_ms_ += FRAME_MS;
+        esphome::stub::set_millis(this->now_ms_);
+        this->loop();
+        return this->state;
+    }
+
+protected:
+    esphome::sensor::Sensor energy_;
+    esphome::sensor::Sensor distance_;
+    BlackBoxStorage black_box_memory_{};
+    uint32_t now_ms_ = 1000;
+};
+
+uint32_t bench_frames() {
+    const char *env = std::getenv("BED_PRESENCE_BENCH_FRAMES");
+    return env != nullptr ? static_cast<uint32_t>(std::strtoul(env, nullptr, 10)) : 1000000u;
+}
+
+// Alternating empty/occupied minutes of integer LD2410 readings. The sleeper lies inside the window; while the
+// bed is empty a third of frames come from the soft margin and a third from beyond it
+std::vector<BenchFrame> make_stream(uint32_t count) {
+    std::vector<BenchFrame> frames(count);
+    uint32_t seed = 2024;
+    for (uint32_t i = 0; i < count; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        bool occupied = (i / MINUTE_FRAMES) % 2 == 1;
+        uint32_t r = seed >> 8;
+        frames[i].energy = static_cast<float>(occupied ? 45 + r % 45 : r % 16);
+        uint32_t band = occupied ? 0 : (seed >> 20) % 3;
+        frames[i].distance_cm = D_MAX_CM + static_cast<float>(band == 0 ? -static_cast<int>(r % 200) - 1
+                                                                        : static_cast<int>((band - 1) * 40 + r % 40));
+    }
+    return frames;
+}
+
+const char *decision_format() {
+#ifdef BED_PRESENCE_FIXED_POINT
+    static char name[16];
+    std::snprintf(name, sizeof(name), "Q%d.%d", 31 - BED_PRESENCE_Q_FRAC_BITS, BED_PRESENCE_Q_FRAC_BITS);
+    return name;
+#else
+    return "float";
+#endif
+}
+
+// The former float finalize: copy, nth_element median, deviations, nth_element MAD
+float sample_sigma(std::vector<float> samples) {
+    auto median_of = [](std::vector<float> &v) {
+        size_t mid = v.size() / 2;
+        std::nth_element(v.begin(), v.begin() + mid, v.end());
+        float m = v[mid];
+        if (v.size() % 2 == 0) {
+            std::nth_element(v.begin(), v.begin() + mid - 1, v.end());
+            m = (m + v[mid - 1]) / 2.0f;
+        }
+        return m;
+    };
+    float median = median_of(samples);
+    for (float &s : samples) {
+        s = std::fabs(s - median);
+    }
+    return std::max(median_of(samples) * 1.4826f, 0.05f);
+}
+
+}  // namespace
+
+TEST(DecisionBenchmarkTest, EngineLoopPerFrameCost) {
+    uint32_t count = bench_frames();
+    ASSERT_GT(count, 0u);
+    std::vector<BenchFrame> frames = make_stream(count);
+    std::vector<uint8_t> decisions(count);
+
+    // Best of three runs on a fresh engine, in ns per frame; every run must decide identically
+    double best = 0.0;
+    for (int run = 0; run < 3; ++run) {
+        BenchEngine engine;
+        std::vector<uint8_t> run_decisions(count);
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; ++i) {
+            run_decisions[i] = engine.frame(frames[i]);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        best = run == 0 ? ns : std::min(best, ns);
+        if (run == 0) {
+            decisions = run_decisions;
+        } else {
+            ASSERT_EQ(run_decisions, decisions) << "run " << run;
+        }
+    }
+
+    uint32_t transitions = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        transitions += decisions[i] != decisions[i - 1];
+    }
+    std::printf("[bench] engine loop: %u frames, %s %.2f ns/frame, %u transitions\n", count, decision_format(),
+                best / static_cast<double>(count), transitions);
+
+    // Each occupied minute ends ON, each empty minute (past the 30 s clear delay and 5 s debounce) ends OFF
+    for (uint32_t end = MINUTE_FRAMES; end <= count; end += MINUTE_FRAMES) {
+        bool occupied = ((end - 1) / MINUTE_FRAMES) % 2 == 1;
+        EXPECT_EQ(decisions[end - 1], occupied) << "minute " << end / MINUTE_FRAMES;
+    }
+}
+
+TEST(DecisionBenchmarkTest, HistogramCalibrationVersusSampleBuffer) {
+    // A 10-minute session at ~7 Hz: both builds keep only the histogram; the buffer is the old float path
+    std::vector<float> samples;
+    EnergyHistogram histogram;
+    uint32_t seed = 99;
+    for (int i = 0; i < 4096; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        float energy = static_cast<float>(4 + (seed >> 16) % 9);
+        samples.push_back(energy);
+        histogram.add(energy);
+    }
+
+    const int rounds = 200;
+    volatile float buffer_sink = 0.0f;
+    volatile DecisionMath::value_t histogram_sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        buffer_sink = sample_sigma(samples);
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        histogram_sink = DecisionMath::histogram_sigma(histogram);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double buffer_us = std::chrono::duration<double, std::micro>(mid - start).count() / rounds;
+    double histogram_us = std::chrono::duration<double, std::micro>(end - mid).count() / rounds;
+    std::printf("[bench] calibration: %zu samples, sample buffer %.1f us + %zu B, histogram %s %.1f us\n",
+                samples.size(), buffer_us, samples.size() * sizeof(float), decision_format(), histogram_us);
+
+    EXPECT_NEAR(DecisionMath::to_float(histogram_sink), buffer_sink, SIGMA_TOLERANCE);
+}
@@ -0,0 +1,269 @@
+/**
+ * Component-Level Engine Tests
+ *
+ * Drives the real BedPresenceEngine (bed_presence.cpp against esphome_stubs/)
+ * through service and slider call sequences that the native model does not
+ * cover: two-class calibration → threshold suggestion → apply, and the staged
+ * profile edits the Home Assistant sliders send around it, plus the sleep-session
+ * publishes.
+ */
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <string>
+
+#include "bed_presence.h"
+
+using esphome::bed_presence_engine::BedPresenceEngine;
+using esphome::bed_presence_engine::BlackBoxStorage;
+using esphome::bed_presence_engine::EngineProfile;
+
+namespace {
+
+class EngineUnderTest : public BedPresenceEngine {
+public:
+    EngineUnderTest() {
+        esphome::stub::set_millis(this->now_ms_);
+        this->black_box_.attach(&this->black_box_memory_);
+        this->set_energy_sensor(&this->energy);
+        this->set_last_change_reason_sensor(&this->change_reason);
+        this->set_suggested_k_on_sensor(&this->suggested_k_on);
+        this->set_suggested_k_off_sensor(&this->suggested_k_off);
+        this->set_session_summary_sensor(&this->session_summary);
+        this->set_session_history_sensor(&this->session_history);
+        this->set_black_box_status_sensor(&this->black_box_status);
+        this->setup();
+    }
+
+    // Radar frames at 10 Hz for `seconds`, still energy uniform over [lo, hi], one loop() per frame
+    void run(uint32_t seconds, uint32_t lo, uint32_t hi) {
+        for (uint32_t i = 0; i < seconds * 10; ++i) {
+            this->seed_ = this->seed_ * 1664525u + 1013904223u;
+            this->energy.publish_state(static_cast<float>(lo + (this->seed_ >> 16) % (hi - lo + 1)));
+            this->now_ms_ += 100;
+            esphome::stub::set_millis(this->now_ms_);
+            this->loop();
+        }
+    }
+
+    // Like the LD2410 component: one publish on change, then the loop keeps re-reading it at 10 Hz
+    void hold(uint32_t seconds, float energy) {
+        if (!this->energy.has_state() || this->energy.state != energy) {
+            this->energy.publish_state(energy);
+        }
+        for (uint32_t i = 0; i < seconds * 10; ++i) {
+            this->now_ms_ += 100;
+            esphome::stub::set_millis(this->now_ms_);
+            this->loop();
+        }
+    }
+
+    // What calibrate_apply_thresholds does after a successful apply: sync the sliders, which stage edits back
+    void sync_threshold_sliders() {
+        this->update_k_on(this->get_k_on());
+        this->update_k_off(this->get_k_off());
+    }
+
+    esphome::sensor::Sensor energy;
+    esphome::text_sensor::TextSensor change_reason;
+    esphome::sensor::Sensor suggested_k_on;
+    esphome::sensor::Sensor suggested_k_off;
+    esphome::sensor::Sensor calibration_quality;
+    esphome::text_sensor::TextSensor session_summary;
+    esphome::text_sensor::TextSensor session_history;
+    esphome::text_sensor::TextSensor black_box_status;
+
+    const esphome::bed_presence_engine::BlackBox &black_box() const { return this->black_box_; }
+
+protected:
+    BlackBoxStorage black_box_memory_{};
+    uint32_t now_ms_ = 1000;
+    uint32_t seed_ = 1;
+};
+
+}  // namespace
+
+TEST(EngineCalibrationFlowTest, OccupiedSessionRequiresBaseline) {
+    EngineUnderTest engine;
+    engine.start_occupied_calibration(60);
+    EXPECT_EQ(engine.change_reason.state, "calibration:baseline_required");
+
+    engine.run(70, 40, 60);  // No session was started, so nothing is learned or suggested
+    EXPECT_FALSE(engine.suggested_k_on.has_state());
+    EXPECT_FALSE(engine.apply_suggested_thresholds());
+    EXPECT_FLOAT_EQ(engine.get_k_on(), 9.0f);
+}
+
+TEST(EngineCalibrationFlowTest, ConstantEnergyBaselineIsAccepted) {
+    EngineUnderTest engine;
+    engine.set_calibration_quality_sensor(&engine.calibration_quality);
+    engine.start_baseline_calibration(60);
+    engine.hold(61, 6.0f);  // A still, empty room: a single energy publish for the whole session
+
+    EXPECT_EQ(engine.change_reason.state, "calibration:completed");
+    ASSERT_TRUE(engine.calibration_quality.has_state());
+    EXPECT_GT(engine.calibration_quality.state, 70.0f);
+}
+
+TEST(EngineCalibrationFlowTest, LongBaselineRunsToItsEnd) {
+    // 10 minutes at 10 Hz is 6000 frames: the histogram has no sample cap that would end it early
+    EngineUnderTest engine;
+    engine.start_baseline_calibration(600);
+    engine.run(590, 4, 9);
+    EXPECT_EQ(engine.change_reason.state, "calibration:started");
+    engine.run(11, 4, 9);
+    EXPECT_EQ(engine.change_reason.state, "calibration:completed");
+}
+
+TEST(EngineCalibrationFlowTest, SuggestsAppliesAndSyncsSliders) {
+    EngineUnderTest engine;
+    engine.start_baseline_calibration(60);
+    engine.run(61, 4, 9);
+    ASSERT_EQ(engine.change_reason.state, "calibration:completed");
+
+    engine.start_occupied_calibration(60);
+    engine.run(61, 20, 40);
+    ASSERT_EQ(engine.change_reason.state, "calibration:thresholds_suggested");
+    ASSERT_TRUE(engine.suggested_k_on.has_state());
+    float k_on = engine.suggested_k_on.state;
+    float k_off = engine.suggested_k_off.state;
+    EXPECT_GT(k_off, 0.0f);
+    EXPECT_GT(k_on, k_off);
+    EXPECT_LT(k_on, EngineProfile::K_MAX);
+
+    // A slider edit still staged when the service runs is superseded by the applied profile
+    engine.update_d_max_cm(20.0f);
+    ASSERT_TRUE(engine.apply_suggested_thresholds());
+    EXPECT_EQ(engine.change_reason.state, "calibration:thresholds_applied");
+    const EngineProfile *applied = &engine.get_active_profile();
+    EXPECT_STREQ(applied->name, "custom");
+    EXPECT_FLOAT_EQ(engine.get_k_on(), k_on);
+    EXPECT_FLOAT_EQ(engine.get_k_off(), k_off);
+    EXPECT_FLOAT_EQ(applied->d_max_cm, 600.0f);
+
+    // Echoing the applied values through the sliders is a no-op, not a second profile
+    engine.sync_threshold_sliders();
+    engine.run(1, 4, 9);
+    EXPECT_EQ(&engine.get_active_profile(), applied);
+    EXPECT_EQ(engine.change_reason.state, "calibration:thresholds_applied");
+
+    // Later slider edits build on the applied thresholds
+    engine.update_k_off(k_off - 1.0f);
+    engine.run(1, 4, 9);
+    EXPECT_EQ(engine.change_reason.state, "profile:custom");
+    EXPECT_FLOAT_EQ(engine.get_k_on(), k_on);
+    EXPECT_FLOAT_EQ(engine.get_k_off(), k_off - 1.0f);
+}
+
+TEST(EngineCalibrationFlowTest, OverlappingClassesGiveNoSuggestion) {
+    EngineUnderTest engine;
+    engine.start_baseline_calibration(60);
+    engine.run(61, 4, 9);
+    engine.start_occupied_calibration(60);
+    engine.run(61, 6, 12);
+
+    EXPECT_EQ(engine.change_reason.state, "calibration:classes_overlap");
+    EXPECT_FALSE(engine.suggested_k_on.has_state());
+    EXPECT_FALSE(engine.apply_suggested_thresholds());
+    EXPECT_FLOAT_EQ(engine.get_k_on(), 9.0f);
+}
+
+TEST(EngineCalibrationFlowTest, WideSeparationStaysWithinSliderRange) {
+    EngineUnderTest engine;
+    engine.start_baseline_calibration(60);
+    engine.run(61, 4, 9);
+    engine.start_occupied_calibration(60);
+    engine.run(61, 80, 95);
+
+    // Unclamped thirds of the gap would put both thresholds beyond the k_on/k_off sliders
+    ASSERT_EQ(engine.change_reason.state, "calibration:thresholds_suggested");
+    float k_on = engine.suggested_k_on.state;
+    EXPECT_LE(k_on, EngineProfile::K_MAX);
+    EXPECT_GT(engine.suggested_k_off.state, 0.0f);
+    EXPECT_LT(engine.suggested_k_off.state, k_on);
+
+    ASSERT_TRUE(engine.apply_suggested_thresholds());
+    EXPECT_FLOAT_EQ(engine.get_k_on(), k_on);
+    engine.sync_threshold_sliders();
+    engine.run(1, 4, 9);
+    EXPECT_EQ(engine.change_reason.state, "calibration:thresholds_applied");
+}
+
+TEST(EngineCalibrationFlowTest, RebaselineRederivesSuggestion) {
+    EngineUnderTest engine;
+    engine.start_baseline_calibration(60);
+    engine.run(61, 4, 9);
+    engine.start_occupied_calibration(60);
+    engine.run(61, 40, 60);
+    ASSERT_EQ(engine.change_reason.state, "calibration:thresholds_suggested");
+    float first_k_on = engine.suggested_k_on.state;
+
+    // A new, noisier empty-bed baseline: the stored suggestion was in k units of the old one
+    engine.start_baseline_calibration(60);
+    engine.run(61, 14, 30);
+    ASSERT_EQ(engine.change_reason.state, "calibration:completed");
+    float k_on = engine.suggested_k_on.state;
+    EXPECT_LT(k_on, first_k_on);
+    EXPECT_GT(engine.suggested_k_off.state, 0.0f);
+
+    ASSERT_TRUE(engine.apply_suggested_thresholds());
+    EXPECT_FLOAT_EQ(engine.get_k_on(), k_on);
+    EXPECT_FLOAT_EQ(engine.get_k_off(), engine.suggested_k_off.state);
+
+    // The occupied bed that was calibrated turns ON against the new baseline
+    engine.run(30, 40, 60);
+    EXPECT_TRUE(engine.state);
+}
+
+TEST(EngineCalibrationFlowTest, RebaselineWithoutOccupiedSessionHasNoSuggestion) {
+    EngineUnderTest engine;
+    engine.start_baseline_calibration(60);
+    engine.run(61, 4, 9);
+    engine.start_baseline_calibration(60);
+    engine.run(61, 14, 30);
+    EXPECT_FALSE(engine.suggested_k_on.has_state());
+    EXPECT_FALSE(engine.apply_suggested_thresholds());
+}
+
+TEST(EngineSessionTest, SummaryAndHistoryCarryStartTime) {
+    EngineUnderTest engine;
+    engine.run(60, 4, 9);         // Empty first minute
+    engine.run(20 * 60, 80, 95);  // 20 min in bed against the default baseline
+    engine.run(16 * 60, 4, 9);    // Empty past the 15 min exit grace: the session closes
+
+    // ON at 1:03 after the debounce; OFF at ~21:35 after the clear delay; closed and published 15 min later
+    ASSERT_FALSE(engine.session_summary.state.empty());
+    EXPECT_EQ(engine.session_summary.state.rfind("started=35m_ago span=20m in_bed=20m exits=0", 0), 0u)
+        << engine.session_summary.state;
+
+    engine.run(10 * 60, 4, 9);  // The history service reports ages at its own publish time (47:00)
+    engine.publish_session_history();
+    EXPECT_EQ(engine.session_history.state.rfind("45/20/20/0/", 0), 0u) << engine.session_history.state;
+}
+
+TEST(EngineBlackBoxTest, OffSnapshotSurvivesLaterOn) {
+    namespace bb = esphome::bed_presence_engine;
+    EngineUnderTest engine;
+    engine.run(60, 80, 95);
+    ASSERT_TRUE(engine.state);
+    engine.run(60, 4, 9);  // OFF after the debounce and clear delay
+    ASSERT_FALSE(engine.state);
+    EXPECT_EQ(engine.black_box_status.state.rfind("frozen:off", 0), 0u);
+    uint32_t off_at = engine.black_box().frozen_at_ms(bb::BLACK_BOX_FROZEN_OFF);
+
+    engine.run(180, 4, 9);  // The live ring wraps before the next ON
+    engine.run(10, 80, 95);
+    ASSERT_TRUE(engine.state);
+    EXPECT_EQ(engine.black_box_status.state.rfind("frozen:on", 0), 0u);
+
+    // The OFF recording is still the one taken at the OFF transition, ending in the OFF decision
+    const bb::BlackBox &box = engine.black_box();
+    EXPECT_EQ(box.frozen_at_ms(bb::BLACK_BOX_FROZEN_OFF), off_at);
+    size_t off_size = box.frozen_size(bb::BLACK_BOX_FROZEN_OFF);
+    ASSERT_GT(off_size, 0u);
+    EXPECT_EQ(box.frozen(bb::BLACK_BOX_FROZEN_OFF, off_size - 1).t_ms, off_at);
+    EXPECT_EQ(box.frozen(bb::BLACK_BOX_FROZEN_OFF, off_size - 1).state, bb::IDLE);
+    EXPECT_GT(box.frozen_at_ms(bb::BLACK_BOX_FROZEN_ON), off_at + 120000);
+    EXPECT_EQ(box.frozen_size(bb::BLACK_BOX_FROZEN_MANUAL), 0u);
+    engine.dump_black_box(true);
+}
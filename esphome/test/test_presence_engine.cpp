@@ -9,193 +9,37 @@
 #include <gtest/gtest.h>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <string>
 #include <vector>
 
-/**
- * Simplified Phase 2 Presence Engine for Testing
- *
- * This models the core Phase 2 logic without ESPHome dependencies:
- * - Z-score calculation
- * - 4-state machine (IDLE, DEBOUNCING_ON, PRESENT, DEBOUNCING_OFF)
- * - Debounce timers with time mocking
- * - Absolute clear delay
- */
-class SimplePresenceEngine {
-public:
-    // State machine states
-    enum State { IDLE, DEBOUNCING_ON, PRESENT, DEBOUNCING_OFF };
-
-    // Configuration (matching actual implementation defaults)
-    float mu_still_ = 100.0f;
-    float sigma_still_ = 20.0f;
-    float k_on_ = 4.0f;
-    float k_off_ = 2.0f;
-    unsigned long on_debounce_ms_ = 3000;
-    unsigned long off_debounce_ms_ = 5000;
-    unsigned long abs_clear_delay_ms_ = 30000;
-    float d_min_cm_ = 0.0f;
-    float d_max_cm_ = 600.0f;
-
-    // State
-    State current_state_ = IDLE;
-    bool binary_output_ = false;  // Simulates binary sensor output
-    std::string last_reason_ = "";
-
-    // Time tracking (mock time for testing)
-    unsigned long mock_time_ = 0;
-    unsigned long debounce_start_time_ = 0;
-    unsigned long last_high_confidence_time_ = 0;
-    bool calibrating_ = false;
-    unsigned long calibration_end_time_ = 0;
-    std::vector<float> calibration_samples_;
-
-    // Z-score calculation: z = (x - μ) / σ
-    float calculate_z_score(float energy) {
-        if (sigma_still_ <= 0.001f) {
-            return 0.0f;  // Prevent division by zero
-        }
-        return (energy - mu_still_) / sigma_still_;
-    }
-
-    // Advance mock time
-    void advance_time(unsigned long ms) {
-        mock_time_ += ms;
-    }
-
-    static float compute_median(std::vector<float> values) {
-        if (values.empty()) {
-            return 0.0f;
-        }
-
-        size_t mid = values.size() / 2;
-        std::nth_element(values.begin(), values.begin() + mid, values.end());
-        float median = values[mid];
-
-        if (values.size() % 2 == 0) {
-            std::nth_element(values.begin(), values.begin() + mid - 1, values.end());
-            median = (median + values[mid - 1]) / 2.0f;
-        }
-        return median;
-    }
-
-    void finalize_calibration() {
-        calibrating_ = false;
-        if (calibration_samples_.empty()) {
-            return;
-        }
-
-        auto samples = calibration_samples_;
-        calibration_samples_.clear();
-
-        float median = compute_median(samples);
-        std::vector<float> deviations(samples.size());
-        for (size_t i = 0; i < samples.size(); ++i) {
-            deviations[i] = std::fabs(samples[i] - median);
-        }
-        float mad = compute_median(deviations);
-        float sigma = mad * 1.4826f;
-        if (sigma < 0.05f) {
-            sigma = 0.05f;
-        }
-
-        mu_still_ = median;
-        sigma_still_ = sigma;
-    }
-
-    void start_calibration(uint32_t duration_s) {
-        calibrating_ = true;
-        calibration_samples_.clear();
-        calibration_end_time_ = mock_time_ + duration_s * 1000UL;
-    }
-
-    void maybe_collect_calibration(float energy) {
-        if (!calibrating_) {
-            return;
-        }
-        calibration_samples_.push_back(energy);
-        if (mock_time_ >= calibration_end_time_) {
-            finalize_calibration();
-        }
-    }
-
-    // Process energy reading (Phase 3 logic: distance window + calibration + state machine)
-    void process_energy(float energy, bool distance_allowed = true) {
-        if (calibrating_ && mock_time_ >= calibration_end_time_) {
-            finalize_calibration();
-        }
-
-        if (!distance_allowed) {
-            return;
-        }
-
-        float z_still = calculate_z_score(energy);
-        unsigned long now = mock_time_;
-
-        maybe_collect_calibration(energy);
-
-        switch (current_state_) {
-            case IDLE:
-                if (z_still >= k_on_) {
-                    debounce_start_time_ = now;
-                    current_state_ = DEBOUNCING_ON;
-                }
-                break;
-
-            case DEBOUNCING_ON:
-                if (z_still >= k_on_) {
-                    // Condition still holds, check timer
-                    if ((now - debounce_start_time_) >= on_debounce_ms_) {
-                        current_state_ = PRESENT;
-                        last_high_confidence_time_ = now;
-                        binary_output_ = true;
-
-                        char buf[64];
-                        snprintf(buf, sizeof(buf), "ON: z=%.2f, debounced %lums", z_still, on_debounce_ms_);
-                        last_reason_ = buf;
-                    }
-                } else {
-                    // Condition lost, abort debounce
-                    current_state_ = IDLE;
-                }
-                break;
-
-            case PRESENT:
-                // Update high confidence timestamp whenever strong signal detected
-                if (z_still > k_on_) {
-                    last_high_confidence_time_ = now;
-                }
-
-                // Check for transition to DEBOUNCING_OFF
-                if (z_still < k_off_) {
-                    // Low signal detected, check absolute clear delay
-                    if ((now - last_high_confidence_time_) >= abs_clear_delay_ms_) {
-                        debounce_start_time_ = now;
-                        current_state_ = DEBOUNCING_OFF;
-                    }
-                }
-                break;
-
-            case DEBOUNCING_OFF:
-                if (z_still < k_off_) {
-                    // Condition still holds, check timer
-                    if ((now - debounce_start_time_) >= off_debounce_ms_) {
-                        current_state_ = IDLE;
-                        binary_output_ = false;
-
-                        char buf[64];
-                        snprintf(buf, sizeof(buf), "OFF: z=%.2f, debounced %lums", z_still, off_debounce_ms_);
-                        last_reason_ = buf;
-                    }
-                } else if (z_still >= k_on_) {
-                    // High signal returned, abort debounce
-                    current_state_ = PRESENT;
-                    last_high_confidence_time_ = now;
-                }
-                break;
-        }
-    }
-};
+#include "black_box.h"
+#include "cadence_controller.h"
+#include "calibration_quality.h"
+#include "energy_histogram.h"
+#include "engine_profile.h"
+#include "fixed_point.h"
+#include "occupancy_hmm.h"
+#include "presence_engine_model.h"
+#include "sleep_session.h"
+
+using esphome::bed_presence_engine::BlackBox;
+using esphome::bed_presence_engine::BlackBoxRecord;
+using esphome::bed_presence_engine::BlackBoxStorage;
+using esphome::bed_presence_engine::CadenceController;
+using esphome::bed_presence_engine::CalibrationQuality;
+using esphome::bed_presence_engine::CalibrationQualityLimits;
+using esphome::bed_presence_engine::CalibrationQualityReport;
+using esphome::bed_presence_engine::EnergyHistogram;
+using esphome::bed_presence_engine::EngineProfile;
+using esphome::bed_presence_engine::FloatMath;
+using esphome::bed_presence_engine::OccupancyHmm;
+using esphome::bed_presence_engine::ProfileStore;
+using esphome::bed_presence_engine::QMath;
+using esphome::bed_presence_engine::SessionSummary;
+using esphome::bed_presence_engine::SleepSessionTracker;
+using esphome::bed_presence_engine::ThresholdSuggestion;
+using esphome::bed_presence_engine::derive_thresholds;
 
 class PresenceEngineTest : public ::testing::Test {
 protected:
@@ -438,18 +282,95 @@ TEST_F(PresenceEngineTest, DistanceWindowBlocksFrames) {
     EXPECT_EQ(engine_.current_state_, SimplePresenceEngine::PRESENT);
 }
 
+TEST_F(PresenceEngineTest, HardGateFreezesStateMachine) {
+    engine_.d_min_cm_ = 50.0f;
+    engine_.d_max_cm_ = 200.0f;
+    engine_.process_frame(185.0f, 100.0f);
+    engine_.advance_time(3000);
+    engine_.process_frame(185.0f, 100.0f);
+    ASSERT_EQ(engine_.current_state_, SimplePresenceEngine::PRESENT);
+
+    // Person drifts past the window edge: frames dropped, timers never advance
+    for (int i = 0; i < 60; ++i) {
+        engine_.advance_time(1000);
+        engine_.process_frame(135.0f, 230.0f);
+    }
+    EXPECT_EQ(engine_.current_state_, SimplePresenceEngine::PRESENT);
+    EXPECT_EQ(engine_.frames_out_of_window_, 60u);
+}
+
+TEST_F(PresenceEngineTest, ZeroEvidenceGateKeepsStateMachineAlive) {
+    engine_.gate_mode_ = SimplePresenceEngine::GATE_ZERO_EVIDENCE;
+    engine_.d_min_cm_ = 50.0f;
+    engine_.d_max_cm_ = 200.0f;
+    engine_.process_frame(185.0f, 100.0f);
+    engine_.advance_time(3000);
+    engine_.process_frame(185.0f, 100.0f);
+    ASSERT_EQ(engine_.current_state_, SimplePresenceEngine::PRESENT);
+
+    // Out-of-window frames count as z=0, so the clear + off debounce timers run
+    for (int i = 0; i < 40; ++i) {
+        engine_.advance_time(1000);
+        engine_.process_frame(185.0f, 230.0f);
+    }
+    EXPECT_EQ(engine_.current_state_, SimplePresenceEngine::IDLE);
+    EXPECT_FALSE(engine_.binary_output_);
+    EXPECT_EQ(engine_.frames_out_of_window_, 40u);
+    EXPECT_EQ(engine_.frames_in_window_, 2u);
+}
+
+TEST_F(PresenceEngineTest, SoftGateWeightsEvidenceByDistance) {
+    engine_.gate_mode_ = SimplePresenceEngine::GATE_SOFT;
+    engine_.d_min_cm_ = 50.0f;
+    engine_.d_max_cm_ = 200.0f;
+    engine_.soft_margin_cm_ = 40.0f;
+
+    EXPECT_FLOAT_EQ(engine_.distance_weight(120.0f), 1.0f);
+    EXPECT_FLOAT_EQ(engine_.distance_weight(200.0f), 1.0f);
+    EXPECT_FLOAT_EQ(engine_.distance_weight(220.0f), 0.5f);  // Midpoint of the falloff
+    EXPECT_FLOAT_EQ(engine_.distance_weight(30.0f), 0.5f);
+    EXPECT_FLOAT_EQ(engine_.distance_weight(240.0f), 0.0f);
+    EXPECT_GT(engine_.distance_weight(205.0f), engine_.distance_weight(215.0f));
+
+    // Strong signal just past the edge still debounces ON (z = 0.95 * 10 = 9.5)
+    engine_.process_frame(300.0f, 205.0f);
+    engine_.advance_time(3000);
+    engine_.process_frame(300.0f, 205.0f);
+    EXPECT_EQ(engine_.current_state_, SimplePresenceEngine::PRESENT);
+    EXPECT_EQ(engine_.frames_attenuated_, 2u);
+
+    // Same signal far outside carries no evidence
+    engine_.process_frame(300.0f, 400.0f);
+    EXPECT_EQ(engine_.frames_out_of_window_, 1u);
+}
+
+TEST_F(PresenceEngineTest, GatedFramesDoNotFeedCalibration) {
+    engine_.gate_mode_ = SimplePresenceEngine::GATE_ZERO_EVIDENCE;
+    engine_.d_min_cm_ = 50.0f;
+    engine_.d_max_cm_ = 200.0f;
+    engine_.start_calibration(5);
+
+    engine_.process_frame(120.0f, 100.0f);
+    engine_.process_frame(500.0f, 300.0f);  // Fan outside the window
+    engine_.process_frame(130.0f, 100.0f);
+    EXPECT_EQ(engine_.calibration_samples_.size(), 2u);
+}
+
 TEST_F(PresenceEngineTest, CalibrationComputesMedianAndMad) {
+    // Only the median/MAD arithmetic here; session scoring has its own tests
+    engine_.calibration_limits_.max_outlier_fraction = 1.5f;
     engine_.start_calibration(2);  // 2 seconds
 
-    engine_.process_energy(120.0f);  // Sample 1
-    engine_.process_energy(110.0f);  // Sample 2
+    auto frame = [this](float energy) { engine_.process_frame(energy, 100.0f); };
+    frame(120.0f);  // Sample 1
+    frame(110.0f);  // Sample 2
     engine_.advance_time(1000);
-    engine_.process_energy(130.0f);  // Sample 3
-    engine_.process_energy(800.0f);  // Outlier
+    frame(130.0f);  // Sample 3
+    frame(800.0f);  // Outlier
 
     // Advance time to finish calibration
     engine_.advance_time(2000);
-    engine_.process_energy(100.0f);  // Trigger finalize
+    frame(100.0f);  // Trigger finalize
 
     // Median of [120,110,130,800] = (120+130)/2 = 125
     EXPECT_FLOAT_EQ(engine_.mu_still_, 125.0f);
@@ -457,6 +378,750 @@ TEST_F(PresenceEngineTest, CalibrationComputesMedianAndMad) {
     EXPECT_NEAR(engine_.sigma_still_, 14.826f, 0.01f);
 }
 
+TEST(EnergyHistogramTest, TailQuantilesRespectRates) {
+    EnergyHistogram hist;
+    for (int i = 1; i <= 100; ++i) {
+        hist.add(static_cast<float>(i));  // One sample per percent 1..100
+    }
+    hist.add(-5.0f);   // Clamped into bin 0
+    hist.add(250.0f);  // Clamped into bin 100
+    EXPECT_EQ(hist.total, 102u);
+    EXPECT_EQ(hist.bins[0], 1u);
+    EXPECT_EQ(hist.bins[100], 2u);
+
+    // 5% of 102 -> at most 5 samples strictly above / below
+    EXPECT_EQ(hist.upper_tail(0.05f), 96);  // 97,98,99,100,100 above
+    EXPECT_EQ(hist.lower_tail(0.05f), 5);   // 0,1,2,3,4 below
+    EXPECT_EQ(hist.upper_tail(0.0f), 100);
+    EXPECT_EQ(hist.lower_tail(0.0f), 0);
+}
+
+TEST(EnergyHistogramTest, MeanAndStddev) {
+    EnergyHistogram hist;
+    EXPECT_EQ(hist.mean(), 0.0f);
+    EXPECT_EQ(hist.stddev(), 0.0f);
+
+    const float values[] = {2.0f, 4.0f, 4.0f, 4.0f, 5.0f, 5.0f, 7.0f, 9.0f};
+    for (float v : values) {
+        hist.add(v);
+    }
+    EXPECT_FLOAT_EQ(hist.mean(), 5.0f);
+    EXPECT_NEAR(hist.stddev(), std::sqrt(32.0f / 7.0f), 1e-5f);  // Sample standard deviation
+    EXPECT_EQ(hist.median_x2(), 9);  // (4 + 5) / 2 = 4.5
+    EXPECT_EQ(hist.mad_x4(9), 2);    // |dev| = 2.5,0.5,0.5,0.5,0.5,0.5,2.5,4.5 -> 0.5
+
+    hist.add(9.0f);  // Odd count: integer median, even half-percent deviations
+    EXPECT_EQ(hist.median_x2(), 10);
+    EXPECT_EQ(hist.mad_x4(10), 4);  // |dev| = 3,1,1,1,0,0,2,4,4 -> 1
+}
+
+TEST(EnergyHistogramTest, DeriveThresholdsFromSeparatedClasses) {
+    EnergyHistogram empty;
+    EnergyHistogram occupied;
+    for (int i = 0; i < 1000; ++i) {
+        empty.add(static_cast<float>(2 + i % 12));      // 2..13
+        occupied.add(static_cast<float>(40 + i % 50));  // 40..89
+    }
+    empty.add(30.0f);  // Single HVAC spike inside the false-on budget
+
+    ThresholdSuggestion s = derive_thresholds(empty, occupied, 6.7f, 3.5f, 0.001f, 0.01f, 15.0f);
+    ASSERT_TRUE(s.valid);
+    EXPECT_EQ(s.empty_upper, 13);
+    EXPECT_EQ(s.occupied_lower, 40);
+    EXPECT_NEAR(s.margin, 27.0f / 3.5f, 1e-4f);
+    EXPECT_NEAR(s.k_off, (22.0f - 6.7f) / 3.5f, 1e-4f);
+    EXPECT_NEAR(s.k_on, (31.0f - 6.7f) / 3.5f, 1e-4f);
+    EXPECT_LT(s.k_off, s.k_on);
+
+    // Both thresholds fall inside the gap, so neither class violates its budget
+    float on_energy = 6.7f + s.k_on * 3.5f;
+    float off_energy = 6.7f + s.k_off * 3.5f;
+    EXPECT_GT(off_energy, static_cast<float>(s.empty_upper));
+    EXPECT_LE(on_energy, static_cast<float>(s.occupied_lower));
+    EXPECT_FALSE(s.clamped);
+
+    // A gap reaching past k_max is split only up to k_max, keeping the same empty-bed floor
+    ThresholdSuggestion clamped = derive_thresholds(empty, occupied, 6.7f, 3.5f, 0.001f, 0.01f, 5.0f);
+    ASSERT_TRUE(clamped.valid);
+    EXPECT_TRUE(clamped.clamped);
+    EXPECT_LE(clamped.k_on, 5.0f);
+    EXPECT_GT(6.7f + clamped.k_off * 3.5f, static_cast<float>(clamped.empty_upper));
+    EXPECT_NEAR(clamped.margin, s.margin, 1e-6f);
+}
+
+TEST(EnergyHistogramTest, DeriveThresholdsRejectsOverlap) {
+    EnergyHistogram empty;
+    EnergyHistogram occupied;
+    for (int i = 0; i < 100; ++i) {
+        empty.add(static_cast<float>(i % 30));          // 0..29
+        occupied.add(static_cast<float>(20 + i % 30));  // 20..49
+    }
+
+    ThresholdSuggestion s = derive_thresholds(empty, occupied, 6.7f, 3.5f, 0.01f, 0.01f, 15.0f);
+    EXPECT_FALSE(s.valid);
+    EXPECT_LE(s.margin, 0.0f);
+
+    // Missing baseline or degenerate sigma never produces a suggestion
+    EXPECT_FALSE(derive_thresholds(EnergyHistogram(), occupied, 6.7f, 3.5f, 0.01f, 0.01f, 15.0f).valid);
+    EXPECT_FALSE(derive_thresholds(empty, occupied, 6.7f, 0.0f, 0.01f, 0.01f, 15.0f).valid);
+}
+
+// Feed one frame per second over [from_s, to_s)
+static bool feed_session(SleepSessionTracker &tracker, uint32_t from_s, uint32_t to_s, bool occupied,
+                         float moving_energy = 0.0f) {
+    bool closed = false;
+    for (uint32_t t = from_s; t < to_s; ++t) {
+        closed |= tracker.update(t * 1000, occupied, moving_energy);
+    }
+    return closed;
+}
+
+TEST(SleepSessionTest, AggregatesNightWithBriefExit) {
+    SleepSessionTracker tracker;
+    tracker.set_exit_grace_ms(15 * 60 * 1000);
+    tracker.set_restless_threshold(30.0f);
+
+    EXPECT_FALSE(feed_session(tracker, 0, 3600, false));               // Empty evening
+    EXPECT_FALSE(feed_session(tracker, 3600, 3600 + 7200, true));      // 2h asleep
+    EXPECT_FALSE(feed_session(tracker, 10800, 10800 + 300, true, 50));  // 5 restless minutes
+    EXPECT_FALSE(feed_session(tracker, 11100, 11100 + 240, false));     // 4 min bathroom trip
+    EXPECT_TRUE(tracker.in_session());
+    EXPECT_FALSE(feed_session(tracker, 11340, 11340 + 3600, true));     // Back to sleep for 1h
+    EXPECT_TRUE(feed_session(tracker, 14940, 14940 + 1200, false));     // Up for the day
+
+    ASSERT_EQ(tracker.history_size(), 1u);
+    const SessionSummary &night = tracker.last();
+    EXPECT_EQ(night.start_ms, 3600u * 1000);
+    EXPECT_EQ(night.span_s, 14940u - 3600u);
+    EXPECT_EQ(night.in_bed_s, 7500u + 3600u);
+    EXPECT_EQ(night.exits, 1u);
+    EXPECT_EQ(night.restless_min, 5u);
+    EXPECT_FALSE(tracker.in_session());
+}
+
+TEST(SleepSessionTest, DropsShortSessionsAndBoundsHistory) {
+    SleepSessionTracker tracker;
+    tracker.set_exit_grace_ms(60 * 1000);
+    tracker.set_min_session_ms(10 * 60 * 1000);
+
+    // Sitting on the bed for 2 minutes never produces a session
+    feed_session(tracker, 0, 120, true);
+    EXPECT_FALSE(feed_session(tracker, 120, 300, false));
+    EXPECT_EQ(tracker.history_size(), 0u);
+
+    // Ten 20-minute sessions keep only the newest HISTORY_SIZE
+    uint32_t t = 300;
+    for (int i = 0; i < 10; ++i) {
+        feed_session(tracker, t, t + 1200 + i * 60, true);
+        t += 1200 + i * 60;
+        EXPECT_TRUE(feed_session(tracker, t, t + 120, false));
+        t += 120;
+    }
+    const size_t capacity = SleepSessionTracker::HISTORY_SIZE;
+    ASSERT_EQ(tracker.history_size(), capacity);
+    EXPECT_EQ(tracker.history(0).span_s, 1200u + 9 * 60);
+    EXPECT_EQ(tracker.history(capacity - 1).span_s, 1200u + 3 * 60);
+}
+
+TEST(EngineProfileTest, ValidateRejectsInconsistentCombinations) {
+    EngineProfile profile;
+    EXPECT_EQ(profile.validate(), nullptr);  // Known-good defaults
+
+    profile.k_on = 3.0f;  // Below k_off=4
+    EXPECT_STREQ(profile.validate(), "k_on_not_above_k_off");
+    profile.k_on = 4.0f;  // Equal: no hysteresis
+    EXPECT_STREQ(profile.validate(), "k_on_not_above_k_off");
+
+    profile = EngineProfile();
+    profile.d_min_cm = 300.0f;
+    profile.d_max_cm = 200.0f;
+    EXPECT_STREQ(profile.validate(), "d_min_not_below_d_max");
+
+    profile = EngineProfile();
+    profile.k_on = std::nanf("");
+    EXPECT_STREQ(profile.validate(), "non_finite");
+}
+
+TEST(EngineProfileTest, StagedEditsApplyOnlyWhenConsistent) {
+    ProfileStore store;
+    const EngineProfile *initial = store.active_ptr();
+    const char *reason = nullptr;
+
+    // Lowering k_on below the current k_off first is held back, not half-applied
+    store.edit().k_on = 3.0f;
+    EXPECT_EQ(store.commit_pending(&reason), ProfileStore::COMMIT_REJECTED);
+    EXPECT_STREQ(reason, "k_on_not_above_k_off");
+    EXPECT_EQ(store.active_ptr(), initial);
+    EXPECT_FLOAT_EQ(store.active().k_on, 9.0f);
+    EXPECT_TRUE(store.has_pending());
+
+    // Completing the edit applies both knobs in one pointer swap
+    store.edit().k_off = 1.5f;
+    EXPECT_EQ(store.commit_pending(&reason), ProfileStore::COMMIT_APPLIED);
+    EXPECT_NE(store.active_ptr(), initial);
+    EXPECT_FLOAT_EQ(store.active().k_on, 3.0f);
+    EXPECT_FLOAT_EQ(store.active().k_off, 1.5f);
+    EXPECT_STREQ(store.active().name, "custom");
+    EXPECT_FALSE(store.has_pending());
+
+    // The previously active custom buffer is never written while active
+    const EngineProfile *custom = store.active_ptr();
+    store.edit().on_debounce_ms = 1000;
+    EXPECT_EQ(store.active().on_debounce_ms, 3000u);
+    EXPECT_EQ(store.commit_pending(&reason), ProfileStore::COMMIT_APPLIED);
+    EXPECT_NE(store.active_ptr(), custom);
+    EXPECT_EQ(store.active().on_debounce_ms, 1000u);
+
+    // Re-publishing identical values (e.g. HA slider sync) is a no-op
+    const EngineProfile *current = store.active_ptr();
+    store.edit().k_on = 3.0f;
+    EXPECT_EQ(store.commit_pending(&reason), ProfileStore::COMMIT_UNCHANGED);
+    EXPECT_EQ(store.active_ptr(), current);
+    EXPECT_EQ(store.commit_pending(&reason), ProfileStore::COMMIT_NONE);
+}
+
+TEST(EngineProfileTest, PresetsSwitchByPointer) {
+    ProfileStore store;
+    EngineProfile night;
+    night.name = "night";
+    night.off_debounce_ms = 10000;
+    EngineProfile broken;
+    broken.name = "broken";
+    broken.k_off = 12.0f;
+
+    EXPECT_EQ(store.add_preset(night), nullptr);
+    EXPECT_STREQ(store.add_preset(night), "duplicate_name");
+    EXPECT_STREQ(store.add_preset(broken), "k_on_not_above_k_off");
+    EXPECT_EQ(store.preset_count(), 2u);
+
+    store.edit().k_on = 3.0f;  // Staged, never committed
+    ASSERT_TRUE(store.select("night"));
+    EXPECT_EQ(store.active_ptr(), store.find("night"));
+    EXPECT_EQ(store.active().off_debounce_ms, 10000u);
+    EXPECT_FALSE(store.has_pending());
+    EXPECT_FALSE(store.select("broken"));
+    EXPECT_FALSE(store.select("missing"));
+
+    ASSERT_TRUE(store.select("default"));
+    EXPECT_EQ(store.active().off_debounce_ms, 5000u);
+}
+
+TEST(EngineProfileTest, GenerationChangesWhenAddressRepeats) {
+    ProfileStore store;
+    EngineProfile night;
+    night.name = "night";
+    ASSERT_EQ(store.add_preset(night), nullptr);
+    const char *reason = nullptr;
+
+    EngineProfile custom;
+    custom.k_on = 10.0f;
+    ASSERT_EQ(store.install(custom), nullptr);
+    const EngineProfile *first = store.active_ptr();
+    uint32_t generation = store.generation();
+
+    // Two more installs land back in the same custom buffer with different parameters
+    custom.k_on = 11.0f;
+    ASSERT_EQ(store.install(custom), nullptr);
+    store.edit().k_on = 12.0f;
+    ASSERT_EQ(store.commit_pending(&reason), ProfileStore::COMMIT_APPLIED);
+    EXPECT_EQ(store.active_ptr(), first);
+    EXPECT_FLOAT_EQ(store.active().k_on, 12.0f);
+    EXPECT_EQ(store.generation(), generation + 2);
+
+    ASSERT_TRUE(store.select("night"));
+    EXPECT_EQ(store.generation(), generation + 3);
+
+    // Nothing changes on a no-op commit or a rejected select
+    store.edit().k_on = 9.0f;
+    EXPECT_EQ(store.commit_pending(&reason), ProfileStore::COMMIT_UNCHANGED);
+    EXPECT_FALSE(store.select("missing"));
+    EXPECT_EQ(store.generation(), generation + 3);
+}
+
+TEST(CadenceControllerTest, DecimatesQuietFramesIntoBlockMeans) {
+    CadenceController cadence;
+    cadence.set_decimation(4);
+
+    // First `decimation` quiet frames run at full rate, then 4:1 block means
+    int admitted = 0;
+    for (int i = 0; i < 4; ++i) {
+        float energy = 5.0f;
+        admitted += cadence.admit(energy, true, 30.0f) ? 1 : 0;
+    }
+    EXPECT_EQ(admitted, 4);
+    EXPECT_TRUE(cadence.decimating());
+
+    const float block[4] = {2.0f, 4.0f, 6.0f, 12.0f};
+    for (int i = 0; i < 3; ++i) {
+        float energy = block[i];
+        EXPECT_FALSE(cadence.admit(energy, true, 30.0f));
+    }
+    float energy = block[3];
+    ASSERT_TRUE(cadence.admit(energy, true, 30.0f));
+    EXPECT_FLOAT_EQ(energy, 6.0f);  // Boxcar mean of the block
+    EXPECT_EQ(cadence.frames_processed(), 5u);
+    EXPECT_EQ(cadence.frames_skipped(), 3u);
+}
+
+TEST(CadenceControllerTest, WakesWithinOneFrame) {
+    CadenceController cadence;
+    cadence.set_decimation(8);
+    for (int i = 0; i < 10; ++i) {
+        float energy = 5.0f;
+        cadence.admit(energy, true, 30.0f);
+    }
+    ASSERT_TRUE(cadence.decimating());
+
+    // A frame near threshold is processed immediately and unaveraged
+    float energy = 31.0f;
+    ASSERT_TRUE(cadence.admit(energy, true, 30.0f));
+    EXPECT_FLOAT_EQ(energy, 31.0f);
+    EXPECT_FALSE(cadence.decimating());
+
+    // Non-IDLE states (or calibration) never decimate
+    cadence.set_decimation(8);
+    for (int i = 0; i < 20; ++i) {
+        float quiet = 5.0f;
+        EXPECT_TRUE(cadence.admit(quiet, false, 30.0f));
+    }
+
+    // Decimation 1 disables the controller entirely
+    CadenceController off;
+    for (int i = 0; i < 20; ++i) {
+        float quiet = 5.0f;
+        EXPECT_TRUE(off.admit(quiet, true, 30.0f));
+    }
+}
+
+// Simulated 60s calibration session scored with the default limits
+struct CalibrationSession {
+    CalibrationQuality quality;
+    EnergyHistogram histogram;
+    std::vector<float> samples;
+
+    CalibrationSession() { quality.start(0, 60000); }
+
+    void frame(uint32_t t_ms, float energy, bool in_window = true) {
+        if (!in_window) {
+            quality.add_rejected();
+            return;
+        }
+        quality.add_sample(t_ms, energy);
+        histogram.add(energy);
+        samples.push_back(energy);
+    }
+
+    CalibrationQualityReport finish() {
+        float median = SimplePresenceEngine::compute_median(samples);
+        std::vector<float> deviations;
+        for (float v : samples) {
+            deviations.push_back(std::fabs(v - median));
+        }
+        float sigma = SimplePresenceEngine::compute_median(deviations) * 1.4826f;
+        return quality.evaluate(60000, histogram, median, sigma, CalibrationQualityLimits());
+    }
+};
+
+TEST(CalibrationQualityTest, CleanEmptyBedPasses) {
+    CalibrationSession session;
+    for (uint32_t t = 0; t < 60000; t += 1000) {
+        session.frame(t, static_cast<float>(5 + (t / 1000) % 4));  // 5..8
+    }
+    CalibrationQualityReport report = session.finish();
+    EXPECT_EQ(report.failure, nullptr);
+    EXPECT_NEAR(report.loop_rate_hz, 1.0f, 1e-3f);
+    EXPECT_EQ(report.rejection_rate, 0.0f);
+    EXPECT_EQ(report.outlier_fraction, 0.0f);
+    EXPECT_GT(report.score, 70.0f);
+}
+
+TEST(CalibrationQualityTest, DetectsWalkThroughAndDrift) {
+    // Someone crosses the room for 6 of 60 seconds
+    CalibrationSession walk;
+    for (uint32_t t = 0; t < 60000; t += 1000) {
+        bool crossing = t >= 20000 && t < 26000;
+        walk.frame(t, crossing ? 60.0f : static_cast<float>(5 + (t / 1000) % 4));
+    }
+    CalibrationQualityReport report = walk.finish();
+    ASSERT_NE(report.failure, nullptr);
+    EXPECT_NEAR(report.outlier_fraction, 0.1f, 1e-3f);
+    EXPECT_TRUE(report.retryable());
+
+    // Baseline steps up halfway (heater switched on): outliers stay low but sub-windows disagree
+    CalibrationSession step;
+    for (uint32_t t = 0; t < 60000; t += 1000) {
+        step.frame(t, static_cast<float>((t < 30000 ? 5 : 10) + (t / 1000) % 4));
+    }
+    report = step.finish();
+    ASSERT_NE(report.failure, nullptr);
+    EXPECT_STREQ(report.failure, "non_stationary");
+    EXPECT_GT(report.drift_sigma, 1.0f);
+}
+
+TEST(CalibrationQualityTest, DetectsStalledLoopAndRejectedFrames) {
+    // Only 5 frames reached the session in 60s (no reading yet, or a stalled main loop)
+    CalibrationSession starved;
+    for (uint32_t t = 0; t < 60000; t += 12000) {
+        starved.frame(t, static_cast<float>(5 + (t / 12000) % 4));
+    }
+    CalibrationQualityReport report = starved.finish();
+    ASSERT_NE(report.failure, nullptr);
+    EXPECT_STREQ(report.failure, "stalled_loop");
+    EXPECT_TRUE(report.retryable());
+
+    // Distance window drops most frames: not worth retrying
+    CalibrationSession rejected;
+    for (uint32_t t = 0; t < 60000; t += 1000) {
+        rejected.frame(t, 6.0f, (t / 1000) % 4 == 0);
+    }
+    report = rejected.finish();
+    ASSERT_NE(report.failure, nullptr);
+    EXPECT_STREQ(report.failure, "distance_rejected");
+    EXPECT_NEAR(report.rejection_rate, 0.75f, 1e-3f);
+    EXPECT_FALSE(report.retryable());
+    EXPECT_LT(report.score, 75.0f);
+}
+
+// Feed `seconds` of constant z at one frame per `frame_ms`
+static float feed_hmm(OccupancyHmm &hmm, float z, int moving, uint32_t seconds, uint32_t frame_ms = 1000) {
+    for (uint32_t t = 0; t < seconds * 1000; t += frame_ms) {
+        hmm.update(z, moving, frame_ms);
+    }
+    return hmm.occupancy();
+}
+
+TEST(OccupancyHmmTest, TracksEnterStayAndLeave) {
+    OccupancyHmm hmm;
+    hmm.set_emissions(0.0f, 1.0f, 14.0f, 2.5f);
+
+    EXPECT_LT(feed_hmm(hmm, 0.5f, 0, 600), 0.01f);
+
+    // Getting in: strong energy with motion, then lying still
+    feed_hmm(hmm, 12.0f, 1, 10);
+    EXPECT_GT(feed_hmm(hmm, 14.0f, 0, 30), 0.99f);
+    EXPECT_EQ(hmm.most_likely(), OccupancyHmm::OCCUPIED_STILL);
+
+    // Rolling over
+    feed_hmm(hmm, 13.0f, 1, 15);
+    EXPECT_EQ(hmm.most_likely(), OccupancyHmm::OCCUPIED_MOVING);
+
+    // Getting up and leaving
+    feed_hmm(hmm, 12.0f, 1, 5);
+    EXPECT_LT(feed_hmm(hmm, 0.0f, 0, 60), 0.05f);
+    EXPECT_EQ(hmm.most_likely(), OccupancyHmm::EMPTY);
+
+    // Probabilities stay normalized throughout
+    float total = 0.0f;
+    for (int i = 0; i < OccupancyHmm::NUM_STATES; ++i) {
+        total += hmm.probability(static_cast<OccupancyHmm::HiddenState>(i));
+    }
+    EXPECT_NEAR(total, 1.0f, 1e-5f);
+}
+
+TEST(OccupancyHmmTest, SingleOutlierFrameDoesNotFlip) {
+    OccupancyHmm hmm;
+    hmm.set_emissions(0.0f, 1.0f, 14.0f, 2.5f);
+    feed_hmm(hmm, 0.0f, 0, 600);
+
+    hmm.update(40.0f, 1, 1000);  // One wild frame
+    EXPECT_LT(hmm.occupancy(), 0.5f);
+    EXPECT_LT(feed_hmm(hmm, 0.0f, 0, 30), 0.01f);
+
+    // NaN input falls back to the prediction instead of poisoning the filter
+    hmm.update(NAN, 0, 1000);
+    EXPECT_TRUE(std::isfinite(hmm.occupancy()));
+    EXPECT_LT(hmm.occupancy(), 0.01f);
+}
+
+TEST(OccupancyHmmTest, EvidenceIsIndependentOfLoopRate) {
+    // A fast loop re-reading the same radar value must not become more confident
+    OccupancyHmm slow;
+    OccupancyHmm fast;
+    slow.set_emissions(0.0f, 1.0f, 14.0f, 2.5f);
+    fast.set_emissions(0.0f, 1.0f, 14.0f, 2.5f);
+
+    float p_slow = feed_hmm(slow, 11.0f, 1, 8, 1000);
+    float p_fast = feed_hmm(fast, 11.0f, 1, 8, 20);
+    EXPECT_GT(p_slow, 0.1f);
+    EXPECT_NEAR(p_fast, p_slow, 0.1f);
+}
+
+// ============================================================================
+// BLACK BOX
+// ============================================================================
+
+namespace bb = esphome::bed_presence_engine;
+
+TEST(BlackBoxTest, RecordsAtIntervalAndOnStateChange) {
+    static BlackBoxStorage storage;
+    std::memset(&storage, 0xA5, sizeof(storage));  // Power-on garbage
+    BlackBox box;
+    EXPECT_FALSE(box.attach(&storage));
+    EXPECT_EQ(box.boot_count(), 0u);
+    ASSERT_EQ(box.live_size(), 1u);
+    uint8_t boot_marker = BlackBoxRecord::BOOT_MARKER;
+    EXPECT_EQ(box.live(0).state, boot_marker);
+
+    // 60 Hz loop for 5 s: one record per second
+    for (uint32_t t = 0; t < 5000; t += 16) {
+        box.record(t, 50, SimplePresenceEngine::IDLE, bb::BLACK_BOX_IN_WINDOW, 0, 0);
+    }
+    EXPECT_EQ(box.live_size(), 6u);
+
+    // A state change is recorded immediately, with saturated fields
+    EXPECT_TRUE(box.record(5010, FloatMath::to_centi(500.0f), SimplePresenceEngine::DEBOUNCING_ON,
+                           bb::BLACK_BOX_ATTENUATED, 12345, 100000000));
+    const BlackBoxRecord &rec = box.live(box.live_size() - 1);
+    EXPECT_EQ(rec.t_ms, 5010u);
+    EXPECT_EQ(rec.z_centi, 32767);
+    EXPECT_EQ(rec.debounce_ds, 123);
+    EXPECT_EQ(rec.high_ds, 0xFFFF);
+    EXPECT_EQ(rec.state, SimplePresenceEngine::DEBOUNCING_ON);
+    EXPECT_EQ(rec.gate, bb::BLACK_BOX_ATTENUATED);
+    EXPECT_FALSE(box.record(5020, 500, SimplePresenceEngine::DEBOUNCING_ON, bb::BLACK_BOX_IN_WINDOW, 10, 0));
+}
+
+TEST(BlackBoxTest, DebounceFlipsAreHeldToTheInterval) {
+    static BlackBoxStorage storage;
+    storage.magic = 0;
+    BlackBox box;
+    box.attach(&storage);
+    box.set_transient_states((1u << SimplePresenceEngine::DEBOUNCING_ON) |
+                             (1u << SimplePresenceEngine::DEBOUNCING_OFF));
+
+    // z hovering at k_on for 60 s at 10 Hz: IDLE ↔ DEBOUNCING_ON on every frame
+    for (uint32_t t = 0; t < 60000; t += 100) {
+        uint8_t state = (t / 100) % 2 ? SimplePresenceEngine::DEBOUNCING_ON : SimplePresenceEngine::IDLE;
+        box.record(t, 900, state, bb::BLACK_BOX_IN_WINDOW, 0, 0);
+    }
+    EXPECT_EQ(box.live_size(), 61u);  // Boot marker + one record per second, as for a steady state
+
+    // The decision itself is recorded at once, and so is the next one
+    EXPECT_TRUE(box.record(60050, 950, SimplePresenceEngine::PRESENT, bb::BLACK_BOX_IN_WINDOW, 3000, 0));
+    EXPECT_FALSE(box.record(60100, 300, SimplePresenceEngine::DEBOUNCING_OFF, bb::BLACK_BOX_IN_WINDOW, 0, 0));
+    EXPECT_TRUE(box.record(60150, 300, SimplePresenceEngine::IDLE, bb::BLACK_BOX_IN_WINDOW, 5000, 0));
+}
+
+TEST(BlackBoxTest, FreezeKeepsNewestWindowOldestFirst) {
+    static BlackBoxStorage storage;
+    storage.magic = 0;
+    BlackBox box;
+    box.attach(&storage);
+
+    uint32_t n = BlackBoxStorage::CAPACITY;
+    for (uint32_t i = 0; i < 3 * n; ++i) {
+        box.record(1000 * (i + 1), static_cast<int16_t>(i), SimplePresenceEngine::PRESENT, bb::BLACK_BOX_IN_WINDOW, 0,
+                   0);
+    }
+    ASSERT_EQ(box.live_size(), n);
+    EXPECT_EQ(box.live(0).t_ms, 1000 * (2 * n + 1));
+
+    ASSERT_EQ(box.freeze(3 * n * 1000, bb::BLACK_BOX_FROZEN_OFF), n);
+    EXPECT_EQ(box.latest_frozen(), bb::BLACK_BOX_FROZEN_OFF);
+    EXPECT_EQ(box.frozen(bb::BLACK_BOX_FROZEN_OFF, 0).t_ms, 1000 * (2 * n + 1));
+    EXPECT_EQ(box.frozen(bb::BLACK_BOX_FROZEN_OFF, n - 1).t_ms, 1000 * 3 * n);
+
+    // Later records do not touch the snapshot
+    for (uint32_t i = 0; i < n / 2; ++i) {
+        box.record(1000 * (3 * n + 1 + i), 0, SimplePresenceEngine::IDLE, bb::BLACK_BOX_IN_WINDOW, 0, 0);
+    }
+    EXPECT_EQ(box.frozen(bb::BLACK_BOX_FROZEN_OFF, n - 1).t_ms, 1000 * 3 * n);
+    EXPECT_EQ(box.frozen(bb::BLACK_BOX_FROZEN_OFF, n - 1).state, SimplePresenceEngine::PRESENT);
+}
+
+TEST(BlackBoxTest, EachReasonKeepsItsOwnSnapshot) {
+    static BlackBoxStorage storage;
+    storage.magic = 0;
+    BlackBox box;
+    box.attach(&storage);
+    EXPECT_EQ(box.latest_frozen(), bb::BLACK_BOX_NOT_FROZEN);
+
+    uint32_t t = 0;
+    auto record_for = [&](uint32_t seconds, uint8_t state) {
+        for (uint32_t end = t + seconds * 1000; t < end; t += 1000) {
+            box.record(t, 100, state, bb::BLACK_BOX_IN_WINDOW, 0, 0);
+        }
+    };
+    record_for(60, SimplePresenceEngine::PRESENT);
+    box.freeze(t, bb::BLACK_BOX_FROZEN_OFF);
+    uint32_t off_at = t;
+
+    // The next ON comes long after the live ring has wrapped; a manual freeze in between
+    record_for(100, SimplePresenceEngine::IDLE);
+    box.freeze(t, bb::BLACK_BOX_FROZEN_MANUAL);
+    record_for(200, SimplePresenceEngine::IDLE);
+    box.freeze(t, bb::BLACK_BOX_FROZEN_ON);
+
+    const size_t capacity = BlackBoxStorage::CAPACITY;
+    EXPECT_EQ(box.latest_frozen(), bb::BLACK_BOX_FROZEN_ON);
+    EXPECT_EQ(box.frozen_at_ms(bb::BLACK_BOX_FROZEN_OFF), off_at);
+    size_t off_size = box.frozen_size(bb::BLACK_BOX_FROZEN_OFF);
+    ASSERT_EQ(off_size, 61u);  // Boot marker + 60 records
+    EXPECT_EQ(box.frozen(bb::BLACK_BOX_FROZEN_OFF, off_size - 1).state, SimplePresenceEngine::PRESENT);
+    EXPECT_EQ(box.frozen_size(bb::BLACK_BOX_FROZEN_MANUAL), capacity);
+    EXPECT_EQ(box.frozen_at_ms(bb::BLACK_BOX_FROZEN_MANUAL), 160000u);
+    EXPECT_EQ(box.frozen_size(bb::BLACK_BOX_FROZEN_ON), capacity);
+    EXPECT_EQ(box.frozen(bb::BLACK_BOX_FROZEN_ON, 0).t_ms, t - 1000 * capacity);
+}
+
+TEST(BlackBoxTest, SurvivesSoftReboot) {
+    static BlackBoxStorage storage;
+    storage.magic = 0;
+    {
+        BlackBox box;
+        box.attach(&storage);
+        for (uint32_t t = 1000; t <= 20000; t += 1000) {
+            box.record(t, 600, SimplePresenceEngine::PRESENT, bb::BLACK_BOX_IN_WINDOW, 0, 0);
+        }
+        box.freeze(20000, bb::BLACK_BOX_FROZEN_ON);
+        box.record(21000, 600, SimplePresenceEngine::PRESENT, bb::BLACK_BOX_IN_WINDOW, 0, 0);
+    }
+
+    // New firmware instance over the same retained memory
+    BlackBox box;
+    EXPECT_TRUE(box.attach(&storage));
+    EXPECT_EQ(box.boot_count(), 1u);
+    EXPECT_EQ(box.latest_frozen(), bb::BLACK_BOX_FROZEN_ON);
+    EXPECT_EQ(box.frozen_boot(bb::BLACK_BOX_FROZEN_ON), 0u);
+    EXPECT_EQ(box.frozen_size(bb::BLACK_BOX_FROZEN_ON), 21u);  // Boot marker + 20 records
+
+    // The live ring continues across the reboot, separated by a boot marker
+    uint8_t boot_marker = BlackBoxRecord::BOOT_MARKER;
+    ASSERT_EQ(box.live_size(), 23u);
+    EXPECT_EQ(box.live(21).t_ms, 21000u);
+    EXPECT_EQ(box.live(22).state, boot_marker);
+
+    // A torn snapshot (count corrupted) is discarded rather than trusted
+    storage.frozen[bb::BLACK_BOX_FROZEN_ON - 1].count = BlackBoxStorage::CAPACITY + 1;
+    BlackBox fresh;
+    EXPECT_FALSE(fresh.attach(&storage));
+    EXPECT_EQ(fresh.latest_frozen(), bb::BLACK_BOX_NOT_FROZEN);
+    EXPECT_EQ(fresh.frozen_size(bb::BLACK_BOX_FROZEN_ON), 0u);
+    EXPECT_EQ(fresh.live_size(), 1u);
+}
+
+// ============================================================================
+// FIXED-POINT DECISION MATH
+// ============================================================================
+
+using Q16 = QMath<16>;
+
+TEST(FixedPointTest, ConversionsRoundAndSaturate) {
+    EXPECT_EQ(Q16::from_float(1.0f), 65536);
+    EXPECT_EQ(Q16::from_float(-0.5f), -32768);
+    EXPECT_EQ(Q16::from_float(1.0f / 131072.0f), 1);  // Half an LSB rounds away from zero
+    EXPECT_EQ(Q16::from_float(1.0e9f), INT32_MAX);
+    EXPECT_EQ(Q16::from_float(-1.0e9f), -INT32_MAX);
+    EXPECT_NEAR(Q16::to_float(Q16::from_float(6.7f)), 6.7f, 1.0f / 131072.0f);
+
+    EXPECT_EQ(Q16::mul(Q16::from_float(1.5f), Q16::from_float(-2.0f)), Q16::from_float(-3.0f));
+    EXPECT_EQ(Q16::div(Q16::from_float(-3.0f), Q16::from_float(2.0f)), Q16::from_float(-1.5f));
+    EXPECT_EQ(Q16::div(Q16::from_float(30000.0f), Q16::from_float(0.001f)), INT32_MAX);
+}
+
+TEST(FixedPointTest, ZScoreAndThresholdsTrackFloat) {
+    // Every LD2410 energy against a spread of baselines: z within a few LSB, same side of k_on/k_off
+    const float baselines[][2] = {{6.7f, 3.5f}, {12.0f, 0.05f}, {0.0f, 1.4826f}, {40.5f, 17.3f}};
+    const float thresholds[] = {9.0f, 4.0f, 3.0f, 1.5f};
+    int disagreements = 0;
+    for (const auto &baseline : baselines) {
+        for (int e = 0; e <= 100; ++e) {
+            float z = FloatMath::z_score(static_cast<float>(e), baseline[0], baseline[1]);
+            int32_t zq = Q16::z_score(Q16::from_float(static_cast<float>(e)), Q16::from_float(baseline[0]),
+                                      Q16::from_float(baseline[1]));
+            EXPECT_NEAR(Q16::to_float(zq), z, std::fabs(z) * 2e-4f + 1e-4f) << "e=" << e;
+            for (float k : thresholds) {
+                disagreements += (z >= k) != (zq >= Q16::from_float(k));
+            }
+        }
+    }
+    EXPECT_EQ(disagreements, 0);
+
+    // Soft gate: smoothstep falloff and evidence blend
+    for (float outside = 0.0f; outside < 40.0f; outside += 0.5f) {
+        float w = FloatMath::falloff(outside, 40.0f);
+        int32_t wq = Q16::falloff(Q16::from_float(outside), Q16::from_float(40.0f));
+        EXPECT_NEAR(Q16::to_float(wq), w, 1e-4f);
+        EXPECT_NEAR(Q16::to_float(Q16::blend(Q16::from_float(6.7f), wq, Q16::from_float(60.0f))),
+                    FloatMath::blend(6.7f, w, 60.0f), 1e-4f * (60.0f - 6.7f));  // Weight error × evidence
+    }
+}
+
+TEST(FixedPointTest, BlackBoxZMatchesFloatAndSaturates) {
+    for (float z = -20.0f; z <= 20.0f; z += 0.37f) {
+        EXPECT_NEAR(Q16::to_centi(Q16::from_float(z)), FloatMath::to_centi(z), 1) << "z=" << z;
+    }
+    EXPECT_EQ(FloatMath::to_centi(500.0f), 32767);
+    EXPECT_EQ(FloatMath::to_centi(-500.0f), -32767);
+    EXPECT_EQ(Q16::to_centi(Q16::from_float(500.0f)), 32767);
+    EXPECT_EQ(Q16::to_centi(Q16::from_float(-500.0f)), -32767);
+}
+
+TEST(FixedPointTest, HistogramBaselineMatchesSampleMedianAndMad) {
+    // Odd and even sample counts, tight and wide rooms, one walk-through outlier
+    uint32_t seed = 7;
+    for (int n : {1, 2, 7, 64, 301, 4096}) {
+        std::vector<float> samples;
+        EnergyHistogram histogram;
+        for (int i = 0; i < n; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            int energy = 5 + static_cast<int>((seed >> 16) % static_cast<uint32_t>(n < 64 ? 3 : 20));
+            if (i == n / 3 && n > 2) {
+                energy = 95;
+            }
+            samples.push_back(static_cast<float>(energy));
+            histogram.add(static_cast<float>(energy));
+        }
+
+        float median = SimplePresenceEngine::compute_median(samples);
+        std::vector<float> deviations;
+        for (float s : samples) {
+            deviations.push_back(std::fabs(s - median));
+        }
+        float sigma = std::max(SimplePresenceEngine::compute_median(deviations) * 1.4826f, 0.05f);
+
+        EXPECT_EQ(Q16::histogram_median(histogram), Q16::from_float(median)) << "n=" << n;
+        EXPECT_NEAR(Q16::to_float(Q16::histogram_sigma(histogram)), sigma, 2.0f / 65536.0f) << "n=" << n;
+    }
+}
+
+TEST(FixedPointTest, DecisionStreamIsBitReproducible) {
+    // Golden digest of z-scores and hysteresis decisions over a fixed soft-gated stream. Pure integer
+    // arithmetic: any host or MCU (with or without FPU, any optimization level) must reproduce it.
+    // Energies and distances are integers, so their float → Q conversion is exact.
+    const int32_t mu = Q16::from_float(6.7f);
+    const int32_t sigma = Q16::from_float(3.5f);
+    const int32_t k_on = Q16::from_float(9.0f);
+    const int32_t k_off = Q16::from_float(4.0f);
+    const int32_t margin = Q16::from_float(40.0f);
+    uint32_t seed = 12345;
+    uint32_t digest = 2166136261u;
+    bool present = false;
+    int transitions = 0;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        int phase = (i / 2000) % 2;
+        int energy = phase ? 30 + static_cast<int>((seed >> 8) % 60) : static_cast<int>((seed >> 8) % 14);
+        int outside = static_cast<int>((seed >> 20) % 60) - 20;  // cm beyond the window edge
+
+        int32_t x = Q16::from_float(static_cast<float>(energy));
+        if (outside >= 40) {
+            continue;
+        }
+        if (outside > 0) {
+            x = Q16::blend(mu, Q16::falloff(Q16::from_float(static_cast<float>(outside)), margin), x);
+        }
+        int32_t z = Q16::z_score(x, mu, sigma);
+        bool next = present ? z >= k_off : z >= k_on;
+        transitions += next != present;
+        present = next;
+        digest = (digest ^ static_cast<uint32_t>(z)) * 16777619u;
+        digest = (digest ^ (present ? 1u : 0u)) * 16777619u;
+    }
+    EXPECT_EQ(transitions, 3159);
+    EXPECT_EQ(digest, 3574683661u);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,299 @@
+/**
+ * Synthetic Scenario Corpus Tests
+ *
+ * Verifies the deterministic LD2410 scenario generator and scores the engine
+ * model over a parallel corpus of labeled nights. Corpus size per scenario kind
+ * defaults to 32 eight-hour scenarios; override with
+ * BED_PRESENCE_CORPUS_SCENARIOS for large-scale runs.
+ */
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "presence_engine_model.h"
+#include "radar_scenario.h"
+
+using radar_scenario::Frame;
+using radar_scenario::ScenarioConfig;
+using radar_scenario::ScenarioGenerator;
+using radar_scenario::ScenarioKind;
+using radar_scenario::Score;
+
+namespace {
+
+// Engine model configured with the production defaults from presence_engine.yaml
+struct ModelStep {
+    SimplePresenceEngine engine;
+
+    ModelStep() {
+        engine.mu_still_ = 6.7f;
+        engine.sigma_still_ = 3.5f;
+        engine.k_on_ = 9.0f;
+        engine.k_off_ = 4.0f;
+    }
+
+    bool operator()(const Frame &frame) {
+        engine.mock_time_ = frame.t_ms;
+        engine.process_frame(frame.still_energy, frame.distance_cm);
+        return engine.binary_output_;
+    }
+};
+
+uint32_t corpus_scenarios() {
+    const char *env = std::getenv("BED_PRESENCE_CORPUS_SCENARIOS");
+    if (env != nullptr && std::atoi(env) > 0) {
+        return static_cast<uint32_t>(std::atoi(env));
+    }
+    return 32;
+}
+
+}  // namespace
+
+TEST(RadarScenarioTest, GeneratorIsDeterministicPerSeed) {
+    ScenarioConfig config;
+    config.duration_ms = 3600UL * 1000UL;
+
+    ScenarioGenerator a(radar_scenario::NIGHT_WAKE, 42, config);
+    ScenarioGenerator b(radar_scenario::NIGHT_WAKE, 42, config);
+    ScenarioGenerator c(radar_scenario::NIGHT_WAKE, 43, config);
+    Frame fa, fb, fc;
+    bool differs = false;
+    while (a.next(fa)) {
+        ASSERT_TRUE(b.next(fb));
+        ASSERT_TRUE(c.next(fc));
+        ASSERT_EQ(fa.t_ms, fb.t_ms);
+        ASSERT_EQ(fa.still_energy, fb.still_energy);
+        ASSERT_EQ(fa.moving_energy, fb.moving_energy);
+        ASSERT_EQ(fa.distance_cm, fb.distance_cm);
+        ASSERT_EQ(fa.occupied, fb.occupied);
+        differs |= fa.still_energy != fc.still_energy;
+    }
+    EXPECT_FALSE(b.next(fb));
+    EXPECT_TRUE(differs);
+}
+
+TEST(RadarScenarioTest, EmptyBedMatchesLd2410Baseline) {
+    ScenarioGenerator generator(radar_scenario::EMPTY_DRIFT, 7);
+    Frame frame;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    uint32_t n = 0;
+    while (generator.next(frame)) {
+        EXPECT_FALSE(frame.occupied);
+        EXPECT_GE(frame.still_energy, 0.0f);
+        EXPECT_LE(frame.still_energy, 100.0f);
+        EXPECT_EQ(frame.still_energy, std::round(frame.still_energy));  // Integer percentages
+        sum += frame.still_energy;
+        sum_sq += frame.still_energy * frame.still_energy;
+        n++;
+    }
+    EXPECT_EQ(n, 8u * 3600u);
+
+    double mean = sum / n;
+    double sd = std::sqrt(sum_sq / n - mean * mean);
+    EXPECT_NEAR(mean, 6.7, 2.0);
+    EXPECT_NEAR(sd, 3.5, 1.0);
+}
+
+TEST(RadarScenarioTest, LabelsFollowScenarioKind) {
+    for (int k = 0; k < radar_scenario::NUM_SCENARIO_KINDS; ++k) {
+        ScenarioKind kind = static_cast<ScenarioKind>(k);
+        for (uint64_t seed = 0; seed < 8; ++seed) {
+            ScenarioGenerator generator(kind, seed);
+            Frame frame;
+            uint32_t occupied = 0;
+            uint32_t frames = 0;
+            uint32_t onsets = 0;
+            bool last = false;
+            while (generator.next(frame)) {
+                occupied += frame.occupied ? 1 : 0;
+                onsets += (frame.occupied && !last) ? 1 : 0;
+                last = frame.occupied;
+                frames++;
+            }
+
+            SCOPED_TRACE(radar_scenario::scenario_name(kind));
+            if (kind == radar_scenario::EMPTY_DRIFT || kind == radar_scenario::HVAC_BURSTS ||
+                kind == radar_scenario::PET_VISITS) {
+                EXPECT_EQ(occupied, 0u);
+            } else {
+                EXPECT_GT(occupied, frames * 8 / 10);
+                EXPECT_LT(occupied, frames);
+                EXPECT_EQ(onsets >= 2, kind == radar_scenario::NIGHT_WAKE);
+            }
+        }
+    }
+}
+
+TEST(RadarScenarioTest, ProductionDefaultsCorpus) {
+    ScenarioConfig config;
+    uint32_t count = corpus_scenarios();
+    auto start = std::chrono::steady_clock::now();
+
+    Score total;
+    for (int k = 0; k < radar_scenario::NUM_SCENARIO_KINDS; ++k) {
+        ScenarioKind kind = static_cast<ScenarioKind>(k);
+        Score score = radar_scenario::run_corpus(kind, 1000, count, config, []() { return ModelStep(); });
+        printf("  %-15s acc=%.4f on=%u/%u (mean %.1fs, max %.1fs) off=%u/%u (mean %.1fs) false_on=%u\n",
+               radar_scenario::scenario_name(kind), score.accuracy(), score.detected_onsets, score.onsets,
+               score.mean_on_latency_s(), score.on_latency_ms_max / 1000.0, score.detected_offsets, score.offsets,
+               score.mean_off_latency_s(), score.false_on_events);
+
+        SCOPED_TRACE(radar_scenario::scenario_name(kind));
+        EXPECT_EQ(score.frames, static_cast<uint64_t>(count) * config.duration_ms / config.frame_ms);
+        EXPECT_EQ(score.detected_onsets, score.onsets);
+        EXPECT_EQ(score.detected_offsets, score.offsets);
+        EXPECT_GT(score.accuracy(), 0.97);
+        total.merge(score);
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double hours = static_cast<double>(total.frames) * config.frame_ms / 3600000.0;
+    printf("  %.0f labeled hours in %.2fs (%.0f h/s)\n", hours, elapsed, hours / elapsed);
+}
+
+TEST(RadarScenarioTest, IdleDecimationKeepsTransitionsIdentical) {
+    ScenarioConfig config;
+    uint64_t frames = 0;
+    uint64_t skipped = 0;
+    uint64_t empty_frames = 0;
+    uint64_t empty_skipped = 0;
+
+    for (int k = 0; k < radar_scenario::NUM_SCENARIO_KINDS; ++k) {
+        ScenarioKind kind = static_cast<ScenarioKind>(k);
+        for (uint64_t seed = 0; seed < 4; ++seed) {
+            ModelStep full;
+            ModelStep decimated;
+            decimated.engine.cadence_.set_decimation(8);
+
+            ScenarioGenerator generator(kind, 200 + seed, config);
+            Frame frame;
+            bool full_out = false;
+            bool decimated_out = false;
+            uint32_t transitions = 0;
+            while (generator.next(frame)) {
+                bool a = full(frame);
+                bool b = decimated(frame);
+                ASSERT_EQ(a, b) << radar_scenario::scenario_name(kind) << " seed " << seed << " t=" << frame.t_ms;
+                ASSERT_EQ(full.engine.current_state_, decimated.engine.current_state_)
+                    << radar_scenario::scenario_name(kind) << " seed " << seed << " t=" << frame.t_ms;
+                transitions += (a != full_out) ? 1 : 0;
+                full_out = a;
+                decimated_out = b;
+            }
+            EXPECT_EQ(full_out, decimated_out);
+
+            uint64_t seen = decimated.engine.cadence_.frames_processed() + decimated.engine.cadence_.frames_skipped();
+            frames += seen;
+            skipped += decimated.engine.cadence_.frames_skipped();
+            if (transitions == 0) {
+                empty_frames += seen;
+                empty_skipped += decimated.engine.cadence_.frames_skipped();
+            }
+        }
+    }
+
+    printf("  decimation 8: skipped %.1f%% of all frames, %.1f%% on empty-bed traces\n",
+           100.0 * skipped / frames, 100.0 * empty_skipped / empty_frames);
+    EXPECT_GT(static_cast<double>(empty_skipped) / empty_frames, 0.75);
+}
+
+TEST(RadarScenarioTest, OccupancyProbabilityIsCalibrated) {
+    // Bed zone at 120cm with a 250cm window, as deployed; HVAC at 350cm is attenuated away
+    ScenarioConfig config;
+    uint64_t frames_high = 0, occupied_high = 0;
+    uint64_t frames_low = 0, occupied_low = 0;
+
+    for (int k = 0; k < radar_scenario::NUM_SCENARIO_KINDS; ++k) {
+        ScenarioKind kind = static_cast<ScenarioKind>(k);
+        if (kind == radar_scenario::PET_VISITS) {
+            continue;  // A pet on the bed is occupancy as far as the radar can tell
+        }
+        uint64_t frames = 0, correct = 0, binary_correct = 0;
+        uint64_t hmm_latency_ms = 0, binary_latency_ms = 0;
+        uint32_t onsets = 0;
+        float max_empty_probability = 0.0f;
+
+        for (uint64_t seed = 0; seed < 8; ++seed) {
+            ModelStep step;
+            step.engine.d_max_cm_ = 250.0f;
+            step.engine.gate_mode_ = SimplePresenceEngine::GATE_SOFT;
+            step.engine.soft_margin_cm_ = 30.0f;
+            step.engine.occupancy_enabled_ = true;
+            step.engine.configure_occupancy();
+
+            ScenarioGenerator generator(kind, 500 + seed, config);
+            Frame frame;
+            bool label = false;
+            uint32_t onset_ms = 0;
+            bool hmm_pending = false, binary_pending = false;
+            while (generator.next(frame)) {
+                step.engine.moving_energy_ = frame.moving_energy;
+                bool binary = step(frame);
+                float p = step.engine.occupancy_.occupancy();
+                bool hmm = p > 0.5f;
+
+                if (frame.occupied && !label) {
+                    onset_ms = frame.t_ms;
+                    hmm_pending = binary_pending = true;
+                    onsets++;
+                }
+                label = frame.occupied;
+                if (hmm_pending && hmm) {
+                    hmm_latency_ms += frame.t_ms - onset_ms;
+                    hmm_pending = false;
+                }
+                if (binary_pending && binary) {
+                    binary_latency_ms += frame.t_ms - onset_ms;
+                    binary_pending = false;
+                }
+
+                frames++;
+                correct += hmm == frame.occupied ? 1 : 0;
+                binary_correct += binary == frame.occupied ? 1 : 0;
+                if (!frame.occupied) {
+                    max_empty_probability = std::max(max_empty_probability, p);
+                }
+                if (p > 0.9f) {
+                    frames_high++;
+                    occupied_high += frame.occupied ? 1 : 0;
+                } else if (p < 0.1f) {
+                    frames_low++;
+                    occupied_low += frame.occupied ? 1 : 0;
+                }
+            }
+        }
+
+        double accuracy = static_cast<double>(correct) / frames;
+        double binary_accuracy = static_cast<double>(binary_correct) / frames;
+        printf("  %-15s p>0.5 acc=%.4f (binary %.4f)", radar_scenario::scenario_name(kind), accuracy, binary_accuracy);
+        SCOPED_TRACE(radar_scenario::scenario_name(kind));
+        if (onsets == 0) {
+            printf(" max p(empty bed)=%.3f\n", max_empty_probability);
+            EXPECT_LT(max_empty_probability, 0.5f);
+            continue;
+        }
+        printf(" onset %.1fs (binary %.1fs)\n", hmm_latency_ms / 1000.0 / onsets, binary_latency_ms / 1000.0 / onsets);
+        EXPECT_LT(hmm_latency_ms, binary_latency_ms);
+        EXPECT_GE(accuracy, binary_accuracy - 0.002);
+    }
+
+    // Confident outputs mean what they say
+    EXPECT_GT(static_cast<double>(occupied_high) / frames_high, 0.99);
+    EXPECT_LT(static_cast<double>(occupied_low) / frames_low, 0.06);
+}
+
+TEST(RadarScenarioTest, CorpusIsIndependentOfThreadCount) {
+    ScenarioConfig config;
+    config.duration_ms = 2UL * 3600UL * 1000UL;
+    auto make = []() { return ModelStep(); };
+
+    Score serial = radar_scenario::run_corpus(radar_scenario::RESTLESS_SLEEP, 5, 12, config, make, 1);
+    Score parallel = radar_scenario::run_corpus(radar_scenario::RESTLESS_SLEEP, 5, 12, config, make, 4);
+    EXPECT_EQ(serial.frames, parallel.frames);
+    EXPECT_EQ(serial.correct, parallel.correct);
+    EXPECT_EQ(serial.on_latency_ms_total, parallel.on_latency_ms_total);
+    EXPECT_EQ(serial.false_on_events, parallel.false_on_events);
+}
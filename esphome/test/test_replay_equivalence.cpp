@@ -0,0 +1,437 @@
+/**
+ * Replay Equivalence Tests
+ *
+ * Compiles the real component (bed_presence.cpp) natively against the ESPHome
+ * stubs in esphome_stubs/ and replays identical traces through it and through
+ * SimplePresenceEngine, one component loop() per model process_frame(). Every
+ * state change, binary output edge and calibration result must match bit for
+ * bit, at the same millisecond.
+ *
+ * Traces come from the synthetic scenario generator (BED_PRESENCE_REPLAY_TRACES,
+ * default 1296 two-hour nights spread over gate modes, window sizes, idle
+ * decimation, loop rates and calibration sessions) and, optionally, from
+ * recorded CSV files in BED_PRESENCE_REPLAY_DIR (header with `t_ms` and
+ * `still_energy` columns, optional `distance_cm`).
+ */
+
+#include <gtest/gtest.h>
+#include <dirent.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bed_presence.h"
+#include "presence_engine_model.h"
+#include "radar_scenario.h"
+
+using esphome::bed_presence_engine::BedPresenceEngine;
+using esphome::bed_presence_engine::BlackBoxStorage;
+using esphome::bed_presence_engine::DecisionMath;
+using esphome::bed_presence_engine::DistanceGateMode;
+using radar_scenario::Frame;
+using radar_scenario::ScenarioConfig;
+using radar_scenario::ScenarioGenerator;
+using radar_scenario::ScenarioKind;
+
+namespace {
+
+// The component with the internals the replay compares made visible
+class DeviceEngine : public BedPresenceEngine {
+public:
+    // Private black-box memory: the firmware's static block would be shared by every worker thread
+    DeviceEngine() { this->black_box_.attach(&this->black_box_memory_); }
+
+    using BedPresenceEngine::current_state_;
+    using BedPresenceEngine::mu_still_;
+    using BedPresenceEngine::sigma_still_;
+    using BedPresenceEngine::frames_in_window_;
+    using BedPresenceEngine::frames_attenuated_;
+    using BedPresenceEngine::frames_out_of_window_;
+    using BedPresenceEngine::cadence_;
+
+protected:
+    BlackBoxStorage black_box_memory_{};
+};
+
+struct ReplayConfig {
+    SimplePresenceEngine::GateMode gate_mode = SimplePresenceEngine::GATE_HARD;
+    float d_max_cm = 600.0f;
+    uint32_t decimation = 1;
+    uint32_t loops_per_frame = 1;     // Component loop() calls per radar frame
+    uint32_t calibration_at_ms = 0;   // 0: no baseline calibration
+    uint32_t calibration_s = 60;
+
+    std::string describe() const {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "gate=%d d_max=%.0f decimation=%u loops=%u calibration=%us@%ums",
+                 static_cast<int>(gate_mode), d_max_cm, decimation, loops_per_frame, calibration_s,
+                 calibration_at_ms);
+        return buf;
+    }
+};
+
+// One observable change: engine state, binary output or baseline statistics
+struct Event {
+    uint32_t t_ms;
+    int state;
+    bool output;
+    uint32_t mu_bits;
+    uint32_t sigma_bits;
+
+    bool operator==(const Event &other) const {
+        return t_ms == other.t_ms && state == other.state && output == other.output && mu_bits == other.mu_bits &&
+               sigma_bits == other.sigma_bits;
+    }
+    bool operator!=(const Event &other) const { return !(*this == other); }
+
+    std::string describe() const {
+        float mu;
+        float sigma;
+        std::memcpy(&mu, &mu_bits, sizeof(mu));
+        std::memcpy(&sigma, &sigma_bits, sizeof(sigma));
+        char buf[96];
+        snprintf(buf, sizeof(buf), "t=%ums state=%d output=%d mu=%.9g sigma=%.9g", t_ms, state, output, mu, sigma);
+        return buf;
+    }
+};
+
+uint32_t float_bits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+void observe(std::vector<Event> &events, uint32_t t_ms, int state, bool output, float mu, float sigma) {
+    Event event{t_ms, state, output, float_bits(mu), float_bits(sigma)};
+    if (events.empty() || events.back().state != state || events.back().output != output ||
+        events.back().mu_bits != event.mu_bits || events.back().sigma_bits != event.sigma_bits) {
+        events.push_back(event);
+    }
+}
+
+/**
+ * Device component and native model driven in lockstep. Each radar frame is
+ * published to the stub sensors once, then loop()/process_frame() run
+ * `loops_per_frame` times across the frame interval, like the ESPHome main
+ * loop re-reading the last value.
+ */
+class ReplayPair {
+public:
+    explicit ReplayPair(const ReplayConfig &config) : config_(config) {
+        esphome::stub::set_millis(0);
+
+        device_.set_energy_sensor(&energy_sensor_);
+        device_.set_distance_sensor(&distance_sensor_);
+        device_.set_distance_gate_mode(static_cast<DistanceGateMode>(config.gate_mode));
+        device_.set_d_max_cm(config.d_max_cm);
+        device_.set_idle_decimation(config.decimation);
+        device_.setup();
+
+        // Production defaults, as in presence_engine.yaml
+        model_.mu_still_ = DecisionMath::to_float(device_.mu_still_);
+        model_.sigma_still_ = DecisionMath::to_float(device_.sigma_still_);
+        model_.k_on_ = device_.get_k_on();
+        model_.k_off_ = device_.get_k_off();
+        const auto &profile = device_.get_active_profile();
+        model_.on_debounce_ms_ = profile.on_debounce_ms;
+        model_.off_debounce_ms_ = profile.off_debounce_ms;
+        model_.abs_clear_delay_ms_ = profile.abs_clear_delay_ms;
+        model_.d_min_cm_ = profile.d_min_cm;
+        model_.d_max_cm_ = profile.d_max_cm;
+        model_.gate_mode_ = config.gate_mode;
+        model_.cadence_.set_decimation(config.decimation);
+    }
+
+    void frame(uint32_t t_ms, float energy, float distance, uint32_t frame_ms) {
+        for (uint32_t i = 0; i < config_.loops_per_frame; ++i) {
+            this->tick(t_ms + i * frame_ms / config_.loops_per_frame, i == 0, energy, distance);
+        }
+    }
+
+    // Empty when both engines agree; otherwise the first divergence
+    std::string compare() const {
+        size_t n = std::min(device_events_.size(), model_events_.size());
+        for (size_t i = 0; i < n; ++i) {
+            if (device_events_[i] != model_events_[i]) {
+                return "event " + std::to_string(i) + ": device " + device_events_[i].describe() + " vs model " +
+                       model_events_[i].describe();
+            }
+        }
+        if (device_events_.size() != model_events_.size()) {
+            const Event &extra = device_events_.size() > n ? device_events_[n] : model_events_[n];
+            return std::string("extra ") + (device_events_.size() > n ? "device" : "model") + " event " +
+                   extra.describe();
+        }
+        if (device_.frames_in_window_ != model_.frames_in_window_ ||
+            device_.frames_attenuated_ != model_.frames_attenuated_ ||
+            device_.frames_out_of_window_ != model_.frames_out_of_window_ ||
+            device_.cadence_.frames_processed() != model_.cadence_.frames_processed()) {
+            return "gate/cadence counters differ";
+        }
+        return "";
+    }
+
+    size_t transitions() const { return device_events_.size(); }
+    bool calibrated() const { return device_events_.back().mu_bits != device_events_.front().mu_bits; }
+
+private:
+    void tick(uint32_t now, bool fresh, float energy, float distance) {
+        esphome::stub::set_millis(now);
+        model_.mock_time_ = now;
+
+        if (config_.calibration_at_ms != 0 && !calibration_started_ && now >= config_.calibration_at_ms) {
+            calibration_started_ = true;
+            device_.start_baseline_calibration(config_.calibration_s);
+            model_.start_calibration(config_.calibration_s);
+        }
+
+        if (fresh) {
+            energy_sensor_.publish_state(energy);
+            distance_sensor_.publish_state(distance);
+        }
+
+        device_.loop();
+        model_.process_frame(energy, distance);
+
+        observe(device_events_, now, device_.current_state_, device_.state, DecisionMath::to_float(device_.mu_still_),
+                DecisionMath::to_float(device_.sigma_still_));
+        observe(model_events_, now, model_.current_state_, model_.binary_output_, model_.mu_still_,
+                model_.sigma_still_);
+    }
+
+    ReplayConfig config_;
+    esphome::sensor::Sensor energy_sensor_;
+    esphome::sensor::Sensor distance_sensor_;
+    DeviceEngine device_;
+    SimplePresenceEngine model_;
+    bool calibration_started_ = false;
+    std::vector<Event> device_events_;
+    std::vector<Event> model_events_;
+};
+
+struct TraceResult {
+    std::string divergence;  // Empty when equivalent
+    size_t events = 0;
+    bool calibrated = false;  // A calibration session was accepted
+};
+
+// Runs `count` independent replays across worker threads; results are indexed by trace
+template <typename Replay>
+std::vector<TraceResult> run_parallel(uint32_t count, Replay replay) {
+    std::vector<TraceResult> results(count);
+    std::atomic<uint32_t> next_index(0);
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < threads; ++w) {
+        workers.emplace_back([&]() {
+            for (uint32_t i = next_index++; i < count; i = next_index++) {
+                results[i] = replay(i);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    return results;
+}
+
+// Deterministic spread of engine configurations over the trace index
+ReplayConfig synthetic_config(uint32_t index) {
+    const uint32_t kinds = radar_scenario::NUM_SCENARIO_KINDS;
+    ReplayConfig config;
+    config.gate_mode = static_cast<SimplePresenceEngine::GateMode>(index / kinds % 3);
+    config.decimation = (index / (kinds * 3)) % 2 ? 8 : 1;
+    config.loops_per_frame = (index / (kinds * 6)) % 2 ? 3 : 1;
+    config.d_max_cm = (index / (kinds * 12)) % 2 ? 250.0f : 600.0f;
+    switch ((index / (kinds * 24)) % 3) {
+        case 1:  // Empty-bed baseline right after boot
+            config.calibration_at_ms = 10000;
+            config.calibration_s = 60;
+            break;
+        case 2:  // Long session mid-night: often occupied, so it may be retried or rejected
+            config.calibration_at_ms = 45UL * 60UL * 1000UL;
+            config.calibration_s = 120;
+            break;
+        default:
+            break;
+    }
+    return config;
+}
+
+uint32_t replay_traces() {
+    const char *env = std::getenv("BED_PRESENCE_REPLAY_TRACES");
+    if (env != nullptr && std::atoi(env) > 0) {
+        return static_cast<uint32_t>(std::atoi(env));
+    }
+    return 1296;
+}
+
+struct RecordedFrame {
+    uint32_t t_ms;
+    float still_energy;
+    float distance_cm;
+};
+
+// Header-driven CSV: t_ms and still_energy required, distance_cm optional (in window when absent)
+bool load_trace(const std::string &path, std::vector<RecordedFrame> &frames) {
+    std::ifstream in(path);
+    std::string line;
+    if (!std::getline(in, line)) {
+        return false;
+    }
+    int t_col = -1;
+    int energy_col = -1;
+    int distance_col = -1;
+    std::stringstream header(line);
+    std::string name;
+    for (int col = 0; std::getline(header, name, ','); ++col) {
+        name.erase(std::remove_if(name.begin(), name.end(), ::isspace), name.end());
+        if (name == "t_ms") {
+            t_col = col;
+        } else if (name == "still_energy") {
+            energy_col = col;
+        } else if (name == "distance_cm") {
+            distance_col = col;
+        }
+    }
+    if (t_col < 0 || energy_col < 0) {
+        return false;
+    }
+
+    while (std::getline(in, line)) {
+        std::stringstream row(line);
+        std::string cell;
+        RecordedFrame frame{0, 0.0f, 100.0f};
+        bool has_t = false;
+        bool has_energy = false;
+        for (int col = 0; std::getline(row, cell, ','); ++col) {
+            if (col == t_col) {
+                frame.t_ms = static_cast<uint32_t>(std::strtoul(cell.c_str(), nullptr, 10));
+                has_t = true;
+            } else if (col == energy_col) {
+                frame.still_energy = std::strtof(cell.c_str(), nullptr);
+                has_energy = true;
+            } else if (col == distance_col) {
+                frame.distance_cm = std::strtof(cell.c_str(), nullptr);
+            }
+        }
+        if (has_t && has_energy) {
+            frames.push_back(frame);
+        }
+    }
+    return !frames.empty();
+}
+
+}  // namespace
+
+TEST(ReplayEquivalenceTest, SyntheticTracesMatchDevice) {
+#ifdef BED_PRESENCE_FIXED_POINT
+    GTEST_SKIP() << "The native model is float only; fixed-point decisions are pinned by FixedPointTest";
+#endif
+    uint32_t count = replay_traces();
+    ScenarioConfig scenario;
+    scenario.duration_ms = 2UL * 3600UL * 1000UL;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<TraceResult> results = run_parallel(count, [&](uint32_t index) {
+        ScenarioKind kind = static_cast<ScenarioKind>(index % radar_scenario::NUM_SCENARIO_KINDS);
+        ReplayPair pair(synthetic_config(index));
+        ScenarioGenerator generator(kind, index, scenario);
+        Frame frame;
+        while (generator.next(frame)) {
+            pair.frame(frame.t_ms, frame.still_energy, frame.distance_cm, scenario.frame_ms);
+        }
+        TraceResult result;
+        result.divergence = pair.compare();
+        result.events = pair.transitions();
+        result.calibrated = pair.calibrated();
+        return result;
+    });
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t events = 0;
+    uint32_t calibrated = 0;
+    uint32_t failures = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        events += results[i].events;
+        calibrated += results[i].calibrated ? 1 : 0;
+        if (!results[i].divergence.empty() && ++failures <= 5) {
+            ADD_FAILURE() << scenario_name(static_cast<ScenarioKind>(i % radar_scenario::NUM_SCENARIO_KINDS))
+                          << " seed " << i << " (" << synthetic_config(i).describe() << "): "
+                          << results[i].divergence;
+        }
+    }
+    printf("[replay] %u traces, %zu events, %u calibrated, %u divergent, %.2fs\n", count, events, calibrated, failures,
+           elapsed);
+    EXPECT_EQ(failures, 0u);
+    // The corpus actually exercises transitions and accepted calibrations
+    EXPECT_GT(events, static_cast<size_t>(count) * 2);
+    if (count >= 432) {
+        EXPECT_GT(calibrated, 0u);
+    }
+}
+
+TEST(ReplayEquivalenceTest, RecordedTracesMatchDevice) {
+#ifdef BED_PRESENCE_FIXED_POINT
+    GTEST_SKIP() << "The native model is float only; fixed-point decisions are pinned by FixedPointTest";
+#endif
+    const char *dir_path = std::getenv("BED_PRESENCE_REPLAY_DIR");
+    if (dir_path == nullptr) {
+        GTEST_SKIP() << "Set BED_PRESENCE_REPLAY_DIR to a directory of recorded CSV traces";
+    }
+
+    std::vector<std::string> paths;
+    if (DIR *dir = opendir(dir_path)) {
+        while (dirent *entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".csv") == 0) {
+                paths.push_back(std::string(dir_path) + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(paths.begin(), paths.end());
+    ASSERT_FALSE(paths.empty()) << "No .csv traces in " << dir_path;
+
+    std::vector<std::vector<RecordedFrame>> traces(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        ASSERT_TRUE(load_trace(paths[i], traces[i])) << "Unreadable trace " << paths[i];
+    }
+
+    // Every recording under every gate mode, decimation and loop rate
+    const uint32_t variants = 12;
+    auto config_for = [](uint32_t variant) {
+        ReplayConfig config;
+        config.gate_mode = static_cast<SimplePresenceEngine::GateMode>(variant % 3);
+        config.decimation = (variant / 3) % 2 ? 8 : 1;
+        config.loops_per_frame = (variant / 6) % 2 ? 3 : 1;
+        return config;
+    };
+    uint32_t count = static_cast<uint32_t>(traces.size()) * variants;
+    std::vector<TraceResult> results = run_parallel(count, [&](uint32_t index) {
+        const std::vector<RecordedFrame> &trace = traces[index / variants];
+        ReplayPair pair(config_for(index % variants));
+        for (size_t i = 0; i < trace.size(); ++i) {
+            uint32_t next = i + 1 < trace.size() ? trace[i + 1].t_ms : trace[i].t_ms + 1000;
+            pair.frame(trace[i].t_ms, trace[i].still_energy, trace[i].distance_cm, next - trace[i].t_ms);
+        }
+        TraceResult result;
+        result.divergence = pair.compare();
+        result.events = pair.transitions();
+        result.calibrated = pair.calibrated();
+        return result;
+    });
+
+    for (uint32_t i = 0; i < count; ++i) {
+        EXPECT_TRUE(results[i].divergence.empty())
+            << paths[i / variants] << " (" << config_for(i % variants).describe() << "): " << results[i].divergence;
+    }
+}